@@ -1,13 +1,19 @@
-﻿// SPDX-License-Identifier: MIT OR Unlicense
+// SPDX-License-Identifier: MIT OR Unlicense
 // smol-cube: https://github.com/aras-p/smol-cube
 
 #include "smol_cube.h"
 #include <assert.h>
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
 #include <string>
 #include <vector>
+#include <atomic>
 #include <charconv>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <new>
 
 #ifdef __APPLE__
 // As of Xcode 15, C++17 from_chars for floats does not exist yet on macOS libraries :(
@@ -228,7 +234,7 @@ static void float_to_half(const float* src, uint16_t* dst, size_t length)
     {
         __m256 src8 = _mm256_loadu_ps(src);
         __m128i h8 = _mm256_cvtps_ph(src8, _MM_FROUND_TO_NEAREST_INT);
-        _mm_storeu_epi32(dst, h8);
+        _mm_storeu_si128((__m128i*)dst, h8);
         src += 8;
         dst += 8;
     }
@@ -264,7 +270,7 @@ static void half_to_float(const uint16_t* src, float* dst, size_t length)
 #if defined(HALF_USES_X64_F16C_CONVERSION)
     for (; i + 7 < length; i += 8)
     {
-        __m128i src8 = _mm_loadu_epi32(src);
+        __m128i src8 = _mm_loadu_si128((const __m128i*)src);
         __m256 f8 = _mm256_cvtph_ps(src8);
         _mm256_storeu_ps(dst, f8);
         src += 8;
@@ -296,6 +302,18 @@ static void half_to_float(const uint16_t* src, float* dst, size_t length)
     }
 }
 
+void smcube_float_to_half(const float* src, uint16_t* dst, size_t count)
+{
+    if (src != nullptr && dst != nullptr)
+        float_to_half(src, dst, count);
+}
+
+void smcube_half_to_float(const uint16_t* src, float* dst, size_t count)
+{
+    if (src != nullptr && dst != nullptr)
+        half_to_float(src, dst, count);
+}
+
 // --------------------------------------------------------------------------
 // Tiny SIMD utility
 
@@ -311,6 +329,19 @@ static void half_to_float(const uint16_t* src, float* dst, size_t length)
 #   error Unsupported platform (SSE/NEON required)
 #endif
 
+// AVX2 code paths: used directly when building for AVX2, otherwise with
+// GCC/Clang compiled for AVX2 target and picked at runtime if CPU has it.
+#if defined(__AVX2__)
+#	define CPU_HAS_AVX2_PATH 1
+#	define CPU_AVX2_TARGET
+#	define cpu_supports_avx2() true
+#elif CPU_ARCH_X64 && (defined(__GNUC__) || defined(__clang__))
+#	define CPU_HAS_AVX2_PATH 1
+#	define CPU_AVX2_TARGET __attribute__((target("avx2")))
+#	define cpu_supports_avx2() __builtin_cpu_supports("avx2")
+#	include <immintrin.h>
+#endif
+
 #if CPU_ARCH_X64
 typedef __m128i Bytes16;
 inline Bytes16 SimdZero() { return _mm_setzero_si128(); }
@@ -325,6 +356,18 @@ template<int index> inline Bytes16 SimdConcat(Bytes16 hi, Bytes16 lo) { return _
 inline Bytes16 SimdAdd(Bytes16 a, Bytes16 b) { return _mm_add_epi8(a, b); }
 inline Bytes16 SimdSub(Bytes16 a, Bytes16 b) { return _mm_sub_epi8(a, b); }
 
+inline Bytes16 SimdAnd(Bytes16 a, Bytes16 b) { return _mm_and_si128(a, b); }
+inline Bytes16 SimdOr(Bytes16 a, Bytes16 b) { return _mm_or_si128(a, b); }
+inline Bytes16 SimdMin(Bytes16 a, Bytes16 b) { return _mm_min_epu8(a, b); }
+inline uint16_t SimdMoveMask(Bytes16 x) { return uint16_t(_mm_movemask_epi8(x)); }
+inline Bytes16 SimdInterleaveLo(Bytes16 a, Bytes16 b) { return _mm_unpacklo_epi8(a, b); }
+inline Bytes16 SimdInterleaveHi(Bytes16 a, Bytes16 b) { return _mm_unpackhi_epi8(a, b); }
+// interleave of 32 bit (D) and 64 bit (Q) elements
+inline Bytes16 SimdInterleaveLoD(Bytes16 a, Bytes16 b) { return _mm_unpacklo_epi32(a, b); }
+inline Bytes16 SimdInterleaveHiD(Bytes16 a, Bytes16 b) { return _mm_unpackhi_epi32(a, b); }
+inline Bytes16 SimdInterleaveLoQ(Bytes16 a, Bytes16 b) { return _mm_unpacklo_epi64(a, b); }
+inline Bytes16 SimdInterleaveHiQ(Bytes16 a, Bytes16 b) { return _mm_unpackhi_epi64(a, b); }
+
 inline Bytes16 SimdShuffle(Bytes16 x, Bytes16 table) { return _mm_shuffle_epi8(x, table); }
 
 inline Bytes16 SimdPrefixSum(Bytes16 x)
@@ -337,6 +380,58 @@ inline Bytes16 SimdPrefixSum(Bytes16 x)
     return x;
 }
 
+// Bytes16 treated as 8 16-bit words
+inline Bytes16 SimdSet1W(uint16_t v) { return _mm_set1_epi16(short(v)); }
+template<int lane> inline uint16_t SimdGetLaneW(Bytes16 x) { return uint16_t(_mm_extract_epi16(x, lane)); }
+inline Bytes16 SimdAddW(Bytes16 a, Bytes16 b) { return _mm_add_epi16(a, b); }
+inline Bytes16 SimdSubW(Bytes16 a, Bytes16 b) { return _mm_sub_epi16(a, b); }
+inline Bytes16 SimdPrefixSumW(Bytes16 x)
+{
+    x = _mm_add_epi16(x, _mm_slli_si128(x, 2));
+    x = _mm_add_epi16(x, _mm_slli_si128(x, 4));
+    x = _mm_add_epi16(x, _mm_slli_si128(x, 8));
+    return x;
+}
+
+typedef __m128 Float4;
+typedef __m128i Int4;
+inline Float4 SimdLoadF(const float* ptr) { return _mm_loadu_ps(ptr); }
+inline void SimdStoreF(float* ptr, Float4 x) { _mm_storeu_ps(ptr, x); }
+inline Float4 SimdSet1F(float v) { return _mm_set1_ps(v); }
+inline Float4 SimdSetF(float a, float b, float c, float d) { return _mm_setr_ps(a, b, c, d); }
+
+inline Float4 SimdAddF(Float4 a, Float4 b) { return _mm_add_ps(a, b); }
+inline Float4 SimdSubF(Float4 a, Float4 b) { return _mm_sub_ps(a, b); }
+inline Float4 SimdMulF(Float4 a, Float4 b) { return _mm_mul_ps(a, b); }
+inline Float4 SimdMinF(Float4 a, Float4 b) { return _mm_min_ps(a, b); }
+inline Float4 SimdMaxF(Float4 a, Float4 b) { return _mm_max_ps(a, b); }
+inline Float4 SimdFloorF(Float4 x) { return _mm_floor_ps(x); }
+
+inline Int4 SimdFloatToInt(Float4 x) { return _mm_cvttps_epi32(x); }
+template<int lane> inline int SimdGetLaneI(Int4 x) { return _mm_extract_epi32(x, lane); }
+template<int lane> inline Float4 SimdSplatF(Float4 x) { return _mm_shuffle_ps(x, x, _MM_SHUFFLE(lane, lane, lane, lane)); }
+inline void SimdTransposeF(Float4& a, Float4& b, Float4& c, Float4& d) { _MM_TRANSPOSE4_PS(a, b, c, d); }
+inline Float4 SimdShuffleF(Float4 x, Bytes16 table) { return _mm_castsi128_ps(_mm_shuffle_epi8(_mm_castps_si128(x), table)); }
+inline Float4 SimdSelectF(Float4 a, Float4 b, Bytes16 mask) { return _mm_blendv_ps(a, b, _mm_castsi128_ps(mask)); }
+
+inline Int4 SimdSet1I(int v) { return _mm_set1_epi32(v); }
+inline Int4 SimdLoadI(const void* ptr) { return _mm_loadu_si128((const __m128i*)ptr); }
+inline void SimdStoreI(void* ptr, Int4 x) { _mm_storeu_si128((__m128i*)ptr, x); }
+inline Int4 SimdLoadU16x4(const uint16_t* ptr) { return _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)ptr)); }
+inline Int4 SimdAddI(Int4 a, Int4 b) { return _mm_add_epi32(a, b); }
+inline Int4 SimdSubI(Int4 a, Int4 b) { return _mm_sub_epi32(a, b); }
+inline Int4 SimdMulI(Int4 a, Int4 b) { return _mm_mullo_epi32(a, b); }
+inline Int4 SimdMinI(Int4 a, Int4 b) { return _mm_min_epi32(a, b); }
+inline Int4 SimdMaxI(Int4 a, Int4 b) { return _mm_max_epi32(a, b); }
+inline Int4 SimdAndI(Int4 a, Int4 b) { return _mm_and_si128(a, b); }
+inline Int4 SimdOrI(Int4 a, Int4 b) { return _mm_or_si128(a, b); }
+template<int n> inline Int4 SimdShiftLeftI(Int4 x) { return _mm_slli_epi32(x, n); }
+template<int n> inline Int4 SimdShiftRightI(Int4 x) { return _mm_srai_epi32(x, n); }
+template<int n> inline Int4 SimdShiftRightLogicalI(Int4 x) { return _mm_srli_epi32(x, n); }
+template<int lane> inline Int4 SimdSplatI(Int4 x) { return _mm_shuffle_epi32(x, _MM_SHUFFLE(lane, lane, lane, lane)); }
+inline Float4 SimdCastToF(Int4 x) { return _mm_castsi128_ps(x); }
+inline Int4 SimdCastToI(Float4 x) { return _mm_castps_si128(x); }
+
 #elif CPU_ARCH_ARM64
 typedef uint8x16_t Bytes16;
 inline Bytes16 SimdZero() { return vdupq_n_u8(0); }
@@ -351,6 +446,23 @@ template<int index> inline Bytes16 SimdConcat(Bytes16 hi, Bytes16 lo) { return v
 inline Bytes16 SimdAdd(Bytes16 a, Bytes16 b) { return vaddq_u8(a, b); }
 inline Bytes16 SimdSub(Bytes16 a, Bytes16 b) { return vsubq_u8(a, b); }
 
+inline Bytes16 SimdAnd(Bytes16 a, Bytes16 b) { return vandq_u8(a, b); }
+inline Bytes16 SimdOr(Bytes16 a, Bytes16 b) { return vorrq_u8(a, b); }
+inline Bytes16 SimdMin(Bytes16 a, Bytes16 b) { return vminq_u8(a, b); }
+inline uint16_t SimdMoveMask(Bytes16 x)
+{
+    static const uint8_t kBits[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    uint8x16_t bits = vandq_u8(vreinterpretq_u8_s8(vshrq_n_s8(vreinterpretq_s8_u8(x), 7)), vld1q_u8(kBits));
+    return uint16_t(vaddv_u8(vget_low_u8(bits)) | (vaddv_u8(vget_high_u8(bits)) << 8));
+}
+inline Bytes16 SimdInterleaveLo(Bytes16 a, Bytes16 b) { return vzip1q_u8(a, b); }
+inline Bytes16 SimdInterleaveHi(Bytes16 a, Bytes16 b) { return vzip2q_u8(a, b); }
+// interleave of 32 bit (D) and 64 bit (Q) elements
+inline Bytes16 SimdInterleaveLoD(Bytes16 a, Bytes16 b) { return vreinterpretq_u8_u32(vzip1q_u32(vreinterpretq_u32_u8(a), vreinterpretq_u32_u8(b))); }
+inline Bytes16 SimdInterleaveHiD(Bytes16 a, Bytes16 b) { return vreinterpretq_u8_u32(vzip2q_u32(vreinterpretq_u32_u8(a), vreinterpretq_u32_u8(b))); }
+inline Bytes16 SimdInterleaveLoQ(Bytes16 a, Bytes16 b) { return vreinterpretq_u8_u64(vzip1q_u64(vreinterpretq_u64_u8(a), vreinterpretq_u64_u8(b))); }
+inline Bytes16 SimdInterleaveHiQ(Bytes16 a, Bytes16 b) { return vreinterpretq_u8_u64(vzip2q_u64(vreinterpretq_u64_u8(a), vreinterpretq_u64_u8(b))); }
+
 inline Bytes16 SimdShuffle(Bytes16 x, Bytes16 table) { return vqtbl1q_u8(x, table); }
 
 inline Bytes16 SimdPrefixSum(Bytes16 x)
@@ -364,8 +476,123 @@ inline Bytes16 SimdPrefixSum(Bytes16 x)
     return x;
 }
 
+// Bytes16 treated as 8 16-bit words
+inline Bytes16 SimdSet1W(uint16_t v) { return vreinterpretq_u8_u16(vdupq_n_u16(v)); }
+template<int lane> inline uint16_t SimdGetLaneW(Bytes16 x) { return vgetq_lane_u16(vreinterpretq_u16_u8(x), lane); }
+inline Bytes16 SimdAddW(Bytes16 a, Bytes16 b) { return vreinterpretq_u8_u16(vaddq_u16(vreinterpretq_u16_u8(a), vreinterpretq_u16_u8(b))); }
+inline Bytes16 SimdSubW(Bytes16 a, Bytes16 b) { return vreinterpretq_u8_u16(vsubq_u16(vreinterpretq_u16_u8(a), vreinterpretq_u16_u8(b))); }
+inline Bytes16 SimdPrefixSumW(Bytes16 x)
+{
+    Bytes16 zero = vdupq_n_u8(0);
+    x = SimdAddW(x, vextq_u8(zero, x, 16 - 2));
+    x = SimdAddW(x, vextq_u8(zero, x, 16 - 4));
+    x = SimdAddW(x, vextq_u8(zero, x, 16 - 8));
+    return x;
+}
+
+typedef float32x4_t Float4;
+typedef int32x4_t Int4;
+inline Float4 SimdLoadF(const float* ptr) { return vld1q_f32(ptr); }
+inline void SimdStoreF(float* ptr, Float4 x) { vst1q_f32(ptr, x); }
+inline Float4 SimdSet1F(float v) { return vdupq_n_f32(v); }
+inline Float4 SimdSetF(float a, float b, float c, float d) { const float v[4] = { a, b, c, d }; return vld1q_f32(v); }
+
+inline Float4 SimdAddF(Float4 a, Float4 b) { return vaddq_f32(a, b); }
+inline Float4 SimdSubF(Float4 a, Float4 b) { return vsubq_f32(a, b); }
+inline Float4 SimdMulF(Float4 a, Float4 b) { return vmulq_f32(a, b); }
+inline Float4 SimdMinF(Float4 a, Float4 b) { return vminq_f32(a, b); }
+inline Float4 SimdMaxF(Float4 a, Float4 b) { return vmaxq_f32(a, b); }
+inline Float4 SimdFloorF(Float4 x) { return vrndmq_f32(x); }
+
+inline Int4 SimdFloatToInt(Float4 x) { return vcvtq_s32_f32(x); }
+template<int lane> inline int SimdGetLaneI(Int4 x) { return vgetq_lane_s32(x, lane); }
+template<int lane> inline Float4 SimdSplatF(Float4 x) { return vdupq_laneq_f32(x, lane); }
+inline void SimdTransposeF(Float4& a, Float4& b, Float4& c, Float4& d)
+{
+    float32x4x2_t ab = vtrnq_f32(a, b);
+    float32x4x2_t cd = vtrnq_f32(c, d);
+    a = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+    b = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+    c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+    d = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+}
+inline Float4 SimdShuffleF(Float4 x, Bytes16 table) { return vreinterpretq_f32_u8(vqtbl1q_u8(vreinterpretq_u8_f32(x), table)); }
+inline Float4 SimdSelectF(Float4 a, Float4 b, Bytes16 mask) { return vbslq_f32(vreinterpretq_u32_u8(mask), b, a); }
+
+inline Int4 SimdSet1I(int v) { return vdupq_n_s32(v); }
+inline Int4 SimdLoadI(const void* ptr) { return vld1q_s32((const int32_t*)ptr); }
+inline void SimdStoreI(void* ptr, Int4 x) { vst1q_s32((int32_t*)ptr, x); }
+inline Int4 SimdLoadU16x4(const uint16_t* ptr) { return vreinterpretq_s32_u32(vmovl_u16(vld1_u16(ptr))); }
+inline Int4 SimdAddI(Int4 a, Int4 b) { return vaddq_s32(a, b); }
+inline Int4 SimdSubI(Int4 a, Int4 b) { return vsubq_s32(a, b); }
+inline Int4 SimdMulI(Int4 a, Int4 b) { return vmulq_s32(a, b); }
+inline Int4 SimdMinI(Int4 a, Int4 b) { return vminq_s32(a, b); }
+inline Int4 SimdMaxI(Int4 a, Int4 b) { return vmaxq_s32(a, b); }
+inline Int4 SimdAndI(Int4 a, Int4 b) { return vandq_s32(a, b); }
+inline Int4 SimdOrI(Int4 a, Int4 b) { return vorrq_s32(a, b); }
+template<int n> inline Int4 SimdShiftLeftI(Int4 x) { return vshlq_n_s32(x, n); }
+template<int n> inline Int4 SimdShiftRightI(Int4 x) { return vshrq_n_s32(x, n); }
+template<int n> inline Int4 SimdShiftRightLogicalI(Int4 x) { return vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_s32(x), n)); }
+template<int lane> inline Int4 SimdSplatI(Int4 x) { return vdupq_laneq_s32(x, lane); }
+inline Float4 SimdCastToF(Int4 x) { return vreinterpretq_f32_s32(x); }
+inline Int4 SimdCastToI(Float4 x) { return vreinterpretq_s32_f32(x); }
+
 #endif
 
+inline Float4 SimdZeroF() { return SimdSet1F(0.0f); }
+inline Float4 SimdLerpF(Float4 a, Float4 b, Float4 t) { return SimdAddF(a, SimdMulF(SimdSubF(b, a), t)); }
+inline Float4 SimdClampF(Float4 x, Float4 lo, Float4 hi) { return SimdMinF(SimdMaxF(x, lo), hi); }
+inline void SimdTransposeI(Int4& a, Int4& b, Int4& c, Int4& d)
+{
+    Float4 fa = SimdCastToF(a), fb = SimdCastToF(b), fc = SimdCastToF(c), fd = SimdCastToF(d);
+    SimdTransposeF(fa, fb, fc, fd);
+    a = SimdCastToI(fa);
+    b = SimdCastToI(fb);
+    c = SimdCastToI(fc);
+    d = SimdCastToI(fd);
+}
+
+// --------------------------------------------------------------------------
+// Tiny threading utility
+
+// Split [0, count) range into contiguous chunks of at least min_chunk items,
+// and call func(begin, end) for each chunk on its own thread. The calling
+// thread processes the first chunk.
+template<typename F>
+static void parallel_for(size_t count, size_t min_chunk, F func)
+{
+    size_t thread_count = std::thread::hardware_concurrency();
+    if (min_chunk < 1)
+        min_chunk = 1;
+    size_t max_threads = (count + min_chunk - 1) / min_chunk;
+    if (thread_count > max_threads)
+        thread_count = max_threads;
+    if (thread_count <= 1)
+    {
+        if (count > 0)
+            func(size_t(0), count);
+        return;
+    }
+
+    const size_t chunk = (count + thread_count - 1) / thread_count;
+    std::vector<std::thread> threads;
+    threads.reserve(thread_count - 1);
+    for (size_t begin = chunk; begin < count; begin += chunk)
+    {
+        size_t end = begin + chunk < count ? begin + chunk : count;
+        threads.emplace_back([=]() { func(begin, end); });
+    }
+    func(size_t(0), chunk);
+    for (std::thread& t : threads)
+        t.join();
+}
+
+static double get_time_ms_since(std::chrono::steady_clock::time_point t0)
+{
+    std::chrono::duration<double, std::milli> dt = std::chrono::steady_clock::now() - t0;
+    return dt.count();
+}
+
 // --------------------------------------------------------------------------
 // "Bytedelta" filter, see
 // https://aras-p.info/blog/2023/03/01/Float-Compression-7-More-Filtering-Optimization/
@@ -422,766 +649,4122 @@ static void FilterByteDelta(const uint8_t* src, uint8_t* dst, int channels, size
     }
 }
 
+// Un-filter one byte lane: dataElems deltas from src are summed up and
+// written into every channels-th byte of dst.
+static void UnFilterByteDeltaLane(const uint8_t* src, uint8_t* dstPtr, int channels, size_t dataElems)
+{
+    uint8_t prev = 0;
+    size_t ip = 0;
+
+    // SIMD loop, 16 bytes at a time
+    Bytes16 prev16 = SimdSet1(prev);
+    Bytes16 hibyte = SimdSet1(15);
+    for (; ip < dataElems / 16; ++ip)
+    {
+        // load 16 bytes of filtered data
+        Bytes16 v = SimdLoad(src);
+        // un-delta via prefix sum
+        prev16 = SimdAdd(SimdPrefixSum(v), SimdShuffle(prev16, hibyte));
+        // scattered write into destination
+        *dstPtr = SimdGetLane<0>(prev16); dstPtr += channels;
+        *dstPtr = SimdGetLane<1>(prev16); dstPtr += channels;
+        *dstPtr = SimdGetLane<2>(prev16); dstPtr += channels;
+        *dstPtr = SimdGetLane<3>(prev16); dstPtr += channels;
+        *dstPtr = SimdGetLane<4>(prev16); dstPtr += channels;
+        *dstPtr = SimdGetLane<5>(prev16); dstPtr += channels;
+        *dstPtr = SimdGetLane<6>(prev16); dstPtr += channels;
+        *dstPtr = SimdGetLane<7>(prev16); dstPtr += channels;
+        *dstPtr = SimdGetLane<8>(prev16); dstPtr += channels;
+        *dstPtr = SimdGetLane<9>(prev16); dstPtr += channels;
+        *dstPtr = SimdGetLane<10>(prev16); dstPtr += channels;
+        *dstPtr = SimdGetLane<11>(prev16); dstPtr += channels;
+        *dstPtr = SimdGetLane<12>(prev16); dstPtr += channels;
+        *dstPtr = SimdGetLane<13>(prev16); dstPtr += channels;
+        *dstPtr = SimdGetLane<14>(prev16); dstPtr += channels;
+        *dstPtr = SimdGetLane<15>(prev16); dstPtr += channels;
+        src += 16;
+    }
+    prev = SimdGetLane<15>(prev16);
+
+    // any trailing leftover
+    for (ip = ip * 16; ip < dataElems; ++ip)
+    {
+        uint8_t v = *src + prev;
+        prev = v;
+        *dstPtr = v;
+        src += 1;
+        dstPtr += channels;
+    }
+}
+
 static void UnFilterByteDelta(const uint8_t* src, uint8_t* dst, int channels, size_t dataElems)
 {
     // "d" case: combined delta+unsplit; SIMD prefix sum delta, unrolled scattered writes into destination
     for (int ich = 0; ich < channels; ++ich)
-    {
-        uint8_t prev = 0;
-        uint8_t* dstPtr = dst + ich;
-        size_t ip = 0;
+        UnFilterByteDeltaLane(src + ich * dataElems, dst + ich, channels, dataElems);
+}
 
-        // SIMD loop, 16 bytes at a time
-        Bytes16 prev16 = SimdSet1(prev);
-        Bytes16 hibyte = SimdSet1(15);
-        for (; ip < dataElems / 16; ++ip)
+// --------------------------------------------------------------------------
+// "Predict3D" filter: each value is predicted from already known X/Y/Z
+// neighbours with a 3D Lorenzo predictor, operating on integer bits of the
+// float (or half) values. Zigzag encoded residuals are split into byte lanes,
+// same layout as ByteDelta. Unlike ByteDelta that only looks at the previous
+// value along X, this also captures correlation along Y and Z.
+//
+// With P(x) = v(x,y-1,z) + v(x,y,z-1) - v(x,y-1,z-1), the value is predicted
+// as v(x-1) + P(x) - P(x-1); neighbours outside of the LUT are zero. This
+// means that D(x) = v(x) - P(x) is a running sum of residuals along the row,
+// which is how rows are decoded: residuals of a whole row are first
+// assembled from the contiguous byte lanes (SIMD byte interleave), and then
+// summed up and added to the predictions, all in the integer width of T.
+// Encoding does the reverse, splitting residuals of a row into byte lanes
+// with SIMD shuffles. The per value prediction math is scalar both ways;
+// the running sum is a serial dependency along each row.
+
+// Assemble count values of T from sizeof(T) byte lanes that are laneStride apart.
+template<typename T>
+static void Predict3DGatherLanes(const uint8_t* src, size_t laneStride, T* dst, size_t count)
+{
+    size_t i = 0;
+    uint8_t* dstBytes = (uint8_t*)dst;
+    if (sizeof(T) == 2)
+    {
+        for (; i + 16 <= count; i += 16)
         {
-            // load 16 bytes of filtered data
-            Bytes16 v = SimdLoad(src);
-            // un-delta via prefix sum
-            prev16 = SimdAdd(SimdPrefixSum(v), SimdShuffle(prev16, hibyte));
-            // scattered write into destination
-            *dstPtr = SimdGetLane<0>(prev16); dstPtr += channels;
-            *dstPtr = SimdGetLane<1>(prev16); dstPtr += channels;
-            *dstPtr = SimdGetLane<2>(prev16); dstPtr += channels;
-            *dstPtr = SimdGetLane<3>(prev16); dstPtr += channels;
-            *dstPtr = SimdGetLane<4>(prev16); dstPtr += channels;
-            *dstPtr = SimdGetLane<5>(prev16); dstPtr += channels;
-            *dstPtr = SimdGetLane<6>(prev16); dstPtr += channels;
-            *dstPtr = SimdGetLane<7>(prev16); dstPtr += channels;
-            *dstPtr = SimdGetLane<8>(prev16); dstPtr += channels;
-            *dstPtr = SimdGetLane<9>(prev16); dstPtr += channels;
-            *dstPtr = SimdGetLane<10>(prev16); dstPtr += channels;
-            *dstPtr = SimdGetLane<11>(prev16); dstPtr += channels;
-            *dstPtr = SimdGetLane<12>(prev16); dstPtr += channels;
-            *dstPtr = SimdGetLane<13>(prev16); dstPtr += channels;
-            *dstPtr = SimdGetLane<14>(prev16); dstPtr += channels;
-            *dstPtr = SimdGetLane<15>(prev16); dstPtr += channels;
-            src += 16;
+            Bytes16 lo = SimdLoad(src + i);
+            Bytes16 hi = SimdLoad(src + laneStride + i);
+            SimdStore(dstBytes + i * 2, SimdInterleaveLo(lo, hi));
+            SimdStore(dstBytes + i * 2 + 16, SimdInterleaveHi(lo, hi));
         }
-        prev = SimdGetLane<15>(prev16);
-
-        // any trailing leftover
-        for (ip = ip * 16; ip < dataElems; ++ip)
+    }
+    else
+    {
+        for (; i + 16 <= count; i += 16)
         {
-            uint8_t v = *src + prev;
-            prev = v;
-            *dstPtr = v;
-            src += 1;
-            dstPtr += channels;
+            Bytes16 b0 = SimdLoad(src + i);
+            Bytes16 b1 = SimdLoad(src + laneStride + i);
+            Bytes16 b2 = SimdLoad(src + laneStride * 2 + i);
+            Bytes16 b3 = SimdLoad(src + laneStride * 3 + i);
+            Bytes16 b02lo = SimdInterleaveLo(b0, b2), b02hi = SimdInterleaveHi(b0, b2);
+            Bytes16 b13lo = SimdInterleaveLo(b1, b3), b13hi = SimdInterleaveHi(b1, b3);
+            SimdStore(dstBytes + i * 4, SimdInterleaveLo(b02lo, b13lo));
+            SimdStore(dstBytes + i * 4 + 16, SimdInterleaveHi(b02lo, b13lo));
+            SimdStore(dstBytes + i * 4 + 32, SimdInterleaveLo(b02hi, b13hi));
+            SimdStore(dstBytes + i * 4 + 48, SimdInterleaveHi(b02hi, b13hi));
         }
     }
+    for (; i < count; ++i)
+    {
+        uint32_t v = 0;
+        for (size_t b = 0; b < sizeof(T); ++b)
+            v |= uint32_t(src[b * laneStride + i]) << (b * 8);
+        dst[i] = T(v);
+    }
 }
 
-// --------------------------------------------------------------------------
-// File parsing
+// Split count values of T into sizeof(T) byte lanes that are laneStride apart;
+// inverse of Predict3DGatherLanes. Bytes of each value are first grouped by
+// lane with a shuffle, and then groups of 16 values are transposed.
+static const uint8_t kSplitWordBytes[16] = { 0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15 };
+static const uint8_t kSplitDwordBytes[16] = { 0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15 };
 
-// chunks:
-// - u32: FOURCC
-// - u64: data_size
-// - u8[data_size]: data
-//
-// header: SML1
-// - no data
-//
-// meta title: Titl
-// - data is the title
-// meta comment: Comm
-// - data is the comment
-// meta domain: Domn
-// - u32: channels (e.g. 3 for RGB)
-// - f32[channels]: min range
-// - f32[channels]: max range
-// LUT/image: ALut
-// - u32: channels (e.g. 3 for RGB)
-// - u32: dimension (1=1D, 2=2D, 3=3D)
-// - u32: data type (0=float)
-// - u32: filter (0=none, 1=bytedelta)
-// - u32x3: dimensions x, y, z
-// - data
+template<typename T>
+static void Predict3DScatterLanes(const T* src, uint8_t* dst, size_t laneStride, size_t count)
+{
+    size_t i = 0;
+    const uint8_t* srcBytes = (const uint8_t*)src;
+    if (sizeof(T) == 2)
+    {
+        const Bytes16 split = SimdLoad(kSplitWordBytes);
+        for (; i + 16 <= count; i += 16)
+        {
+            Bytes16 v0 = SimdShuffle(SimdLoad(srcBytes + i * 2), split);
+            Bytes16 v1 = SimdShuffle(SimdLoad(srcBytes + i * 2 + 16), split);
+            SimdStore(dst + i, SimdInterleaveLoQ(v0, v1));
+            SimdStore(dst + laneStride + i, SimdInterleaveHiQ(v0, v1));
+        }
+    }
+    else
+    {
+        const Bytes16 split = SimdLoad(kSplitDwordBytes);
+        for (; i + 16 <= count; i += 16)
+        {
+            Bytes16 v0 = SimdShuffle(SimdLoad(srcBytes + i * 4), split);
+            Bytes16 v1 = SimdShuffle(SimdLoad(srcBytes + i * 4 + 16), split);
+            Bytes16 v2 = SimdShuffle(SimdLoad(srcBytes + i * 4 + 32), split);
+            Bytes16 v3 = SimdShuffle(SimdLoad(srcBytes + i * 4 + 48), split);
+            Bytes16 v01lo = SimdInterleaveLoD(v0, v1), v01hi = SimdInterleaveHiD(v0, v1);
+            Bytes16 v23lo = SimdInterleaveLoD(v2, v3), v23hi = SimdInterleaveHiD(v2, v3);
+            SimdStore(dst + i, SimdInterleaveLoQ(v01lo, v23lo));
+            SimdStore(dst + laneStride + i, SimdInterleaveHiQ(v01lo, v23lo));
+            SimdStore(dst + laneStride * 2 + i, SimdInterleaveLoQ(v01hi, v23hi));
+            SimdStore(dst + laneStride * 3 + i, SimdInterleaveHiQ(v01hi, v23hi));
+        }
+    }
+    for (; i < count; ++i)
+    {
+        for (size_t b = 0; b < sizeof(T); ++b)
+            dst[b * laneStride + i] = uint8_t(src[i] >> (b * 8));
+    }
+}
 
-struct smcube_lut
+// When decoding, rowDone(y + z * sizeY) is called for each decoded row once
+// no later row is predicted from it anymore, i.e. about one slice behind.
+template<typename T, bool Decode, int channels, typename RowDone>
+static void Predict3DFilter(const uint8_t* src, uint8_t* dst, int sizeX, int sizeY, int sizeZ, RowDone rowDone)
 {
-    int channels = 3; // 3=RGB, 4=RGBA
-    int dimension = 3; // 1=1D, 2=2D, 3=3D
-    smcube_data_type data_type = smcube_data_type::Float32;
-    int size_x = 1;
-    int size_y = 1;
-    int size_z = 1;
-    void* data = nullptr;
-};
+    const int bits = sizeof(T) * 8;
+    const size_t rowSize = size_t(sizeX);
+    const size_t sliceSize = rowSize * sizeY;
+    const size_t dataElems = sliceSize * sizeZ;
+    const T* values = (const T*)(Decode ? dst : src);
+    // neighbors outside of the LUT are read from a row of zeroes
+    std::vector<T> zeroRow(rowSize * channels, T(0));
+    // zigzag encoded residuals of one row, each channel separately
+    std::vector<T> residuals(rowSize * channels);
+    size_t index = 0;
+    for (int z = 0; z < sizeZ; ++z)
+    {
+        for (int y = 0; y < sizeY; ++y, index += rowSize)
+        {
+            const size_t rowStart = index * channels;
+            const T* rowY = y > 0 ? values + rowStart - rowSize * channels : zeroRow.data();
+            const T* rowZ = z > 0 ? values + rowStart - sliceSize * channels : zeroRow.data();
+            const T* rowYZ = y > 0 && z > 0 ? values + rowStart - (rowSize + sliceSize) * channels : zeroRow.data();
+            T sum[channels] = {};
+            if (Decode)
+            {
+                for (int ch = 0; ch < channels; ++ch)
+                    Predict3DGatherLanes<T>(src + ch * sizeof(T) * dataElems + index, dataElems, residuals.data() + ch * rowSize, rowSize);
+                T* row = (T*)dst + rowStart;
+                for (size_t x = 0; x < rowSize; ++x)
+                {
+                    for (int ch = 0; ch < channels; ++ch)
+                    {
+                        const size_t i = x * channels + ch;
+                        const T zz = residuals[ch * rowSize + x];
+                        sum[ch] = T(sum[ch] + T((zz >> 1) ^ T(0 - (zz & 1))));
+                        row[i] = T(rowY[i] + rowZ[i] - rowYZ[i] + sum[ch]);
+                    }
+                }
+                const size_t rowIndex = size_t(z) * sizeY + y;
+                if (y > 0 && z > 0)
+                    rowDone(rowIndex - sizeY - 1);
+                if (y == sizeY - 1 && z > 0)
+                    rowDone(rowIndex - sizeY);
+            }
+            else
+            {
+                const T* row = values + rowStart;
+                for (size_t x = 0; x < rowSize; ++x)
+                {
+                    for (int ch = 0; ch < channels; ++ch)
+                    {
+                        const size_t i = x * channels + ch;
+                        const T d = T(row[i] - (rowY[i] + rowZ[i] - rowYZ[i]));
+                        const T r = T(d - sum[ch]);
+                        sum[ch] = d;
+                        residuals[ch * rowSize + x] = T(T(r << 1) ^ T(0 - (r >> (bits - 1))));
+                    }
+                }
+                for (int ch = 0; ch < channels; ++ch)
+                    Predict3DScatterLanes<T>(residuals.data() + ch * rowSize, dst + ch * sizeof(T) * dataElems + index, dataElems, rowSize);
+            }
+        }
+    }
+    if (Decode)
+    {
+        for (int y = 0; y < sizeY; ++y)
+            rowDone(size_t(sizeZ - 1) * sizeY + y);
+    }
+}
 
-size_t smcube_data_type_get_size(smcube_data_type type)
+template<typename T, bool Decode, typename RowDone>
+static void Predict3DFilterChannels(const uint8_t* src, uint8_t* dst, int channels, int sizeX, int sizeY, int sizeZ, RowDone rowDone)
 {
-    switch (type) {
-    case smcube_data_type::Float32: return 4;
-    case smcube_data_type::Float16: return 2;
-    default: assert(false); return 0;
+    switch (channels) {
+    case 1: Predict3DFilter<T, Decode, 1>(src, dst, sizeX, sizeY, sizeZ, rowDone); break;
+    case 2: Predict3DFilter<T, Decode, 2>(src, dst, sizeX, sizeY, sizeZ, rowDone); break;
+    case 3: Predict3DFilter<T, Decode, 3>(src, dst, sizeX, sizeY, sizeZ, rowDone); break;
+    case 4: Predict3DFilter<T, Decode, 4>(src, dst, sizeX, sizeY, sizeZ, rowDone); break;
+    default: assert(false);
     }
 }
 
-struct smcube_file_alut_header
+static void FilterPredict3D(const uint8_t* src, uint8_t* dst, int typeSize, int channels, int sizeX, int sizeY, int sizeZ)
 {
-    uint32_t channels;
-    uint32_t dimension;
-    uint32_t data_type;
-    uint32_t filter;
-    uint32_t size_x;
-    uint32_t size_y;
-    uint32_t size_z;
-};
-static_assert(sizeof(smcube_file_alut_header) == 28, "Unexpected smcube_file_alut_header size");
+    auto noRowDone = [](size_t) {};
+    if (typeSize == 2)
+        Predict3DFilterChannels<uint16_t, false>(src, dst, channels, sizeX, sizeY, sizeZ, noRowDone);
+    else
+        Predict3DFilterChannels<uint32_t, false>(src, dst, channels, sizeX, sizeY, sizeZ, noRowDone);
+}
 
-enum class smcube_data_filter : uint32_t
+template<typename RowDone>
+static void UnFilterPredict3D(const uint8_t* src, uint8_t* dst, int typeSize, int channels, int sizeX, int sizeY, int sizeZ, RowDone rowDone)
 {
-    None = 0,
-    ByteDelta,
-    FilterCount
-};
+    if (typeSize == 2)
+        Predict3DFilterChannels<uint16_t, true>(src, dst, channels, sizeX, sizeY, sizeZ, rowDone);
+    else
+        Predict3DFilterChannels<uint32_t, true>(src, dst, channels, sizeX, sizeY, sizeZ, rowDone);
+}
 
-struct smcube_luts
+// --------------------------------------------------------------------------
+// "WordDelta" and "BitShuffle" filters, for Float16 data. Both take deltas of
+// whole 16 bit values (instead of separate bytes like ByteDelta) along X, for
+// each channel. WordDelta stores low and high bytes of the deltas in two byte
+// lanes per channel. BitShuffle transposes deltas of each channel into 16 bit
+// planes, 16 values at a time: each block of 16 values becomes 2 bytes in
+// each plane. Deltas of the last (count % 16) values follow the planes as
+// they are (low, high byte).
+
+static const uint8_t kLastWord[16] = { 14, 15, 14, 15, 14, 15, 14, 15, 14, 15, 14, 15, 14, 15, 14, 15 };
+
+static inline Bytes16 GatherWords8(const uint16_t* src, int channels)
 {
-    uint8_t* file_data = nullptr;
-    size_t file_data_size = 0;
-    std::string title;
-    std::string comment;
-    std::vector<smcube_lut> luts;
-};
+    uint16_t w[8];
+    for (int i = 0; i < 8; ++i)
+        w[i] = src[i * channels];
+    return SimdLoad(w);
+}
 
-bool smcube_save_to_file_smcube(const char* path, const smcube_luts* luts, smcube_save_flags flags)
+// Scattered write of 8 words into every channels-th word of destination.
+static inline uint16_t* ScatterWords8(uint16_t* dst, int channels, Bytes16 v)
 {
-    if (path == nullptr || luts == nullptr)
-        return false;
+    *dst = SimdGetLaneW<0>(v); dst += channels;
+    *dst = SimdGetLaneW<1>(v); dst += channels;
+    *dst = SimdGetLaneW<2>(v); dst += channels;
+    *dst = SimdGetLaneW<3>(v); dst += channels;
+    *dst = SimdGetLaneW<4>(v); dst += channels;
+    *dst = SimdGetLaneW<5>(v); dst += channels;
+    *dst = SimdGetLaneW<6>(v); dst += channels;
+    *dst = SimdGetLaneW<7>(v); dst += channels;
+    return dst;
+}
 
-    FILE* f = fopen(path, "wb");
-    if (f == nullptr)
-        return false;
+// Deltas of 8 words against the preceding ones, with low bytes in the
+// first half of result and high bytes in the second half.
+static inline Bytes16 WordDelta8(Bytes16 v, Bytes16 prev8)
+{
+    return SimdShuffle(SimdSubW(v, SimdConcat<14>(v, prev8)), SimdLoad(kSplitWordBytes));
+}
 
-    fwrite("SML1", 1, 4, f);
-    if (!luts->title.empty())
+static void FilterWordDelta(const uint8_t* src, uint8_t* dst, int channels, size_t dataElems)
+{
+    const uint16_t* srcW = (const uint16_t*)src;
+    for (int ich = 0; ich < channels; ++ich)
     {
-        uint64_t len = luts->title.size();
-        fwrite("Titl", 1, 4, f);
-        fwrite(&len, sizeof(len), 1, f);
-        fwrite(luts->title.data(), 1, len, f);
+        uint8_t* dstLo = dst + ich * 2 * dataElems;
+        uint8_t* dstHi = dstLo + dataElems;
+        Bytes16 prev8 = SimdZero();
+        size_t ip = 0;
+        for (; ip + 8 <= dataElems; ip += 8)
+        {
+            Bytes16 v = GatherWords8(srcW + ip * channels + ich, channels);
+            uint8_t delta[16];
+            SimdStore(delta, WordDelta8(v, prev8));
+            memcpy(dstLo + ip, delta, 8);
+            memcpy(dstHi + ip, delta + 8, 8);
+            prev8 = v;
+        }
+        uint16_t prev = SimdGetLaneW<7>(prev8);
+        for (; ip < dataElems; ++ip)
+        {
+            uint16_t v = srcW[ip * channels + ich];
+            uint16_t delta = uint16_t(v - prev);
+            prev = v;
+            dstLo[ip] = uint8_t(delta);
+            dstHi[ip] = uint8_t(delta >> 8);
+        }
     }
-    if (!luts->comment.empty())
+}
+
+static void UnFilterWordDelta(const uint8_t* src, uint8_t* dst, int channels, size_t dataElems)
+{
+    const Bytes16 lastWord = SimdLoad(kLastWord);
+    for (int ich = 0; ich < channels; ++ich)
     {
-        uint64_t len = luts->comment.size();
-        fwrite("Comm", 1, 4, f);
-        fwrite(&len, sizeof(len), 1, f);
-        fwrite(luts->comment.data(), 1, len, f);
+        const uint8_t* srcLo = src + ich * 2 * dataElems;
+        const uint8_t* srcHi = srcLo + dataElems;
+        uint16_t* dstPtr = (uint16_t*)dst + ich;
+        Bytes16 prev8 = SimdZero();
+        size_t ip = 0;
+
+        // SIMD loop, 16 words at a time: interleave bytes into words, un-delta via prefix sum
+        for (; ip + 16 <= dataElems; ip += 16)
+        {
+            Bytes16 lo = SimdLoad(srcLo + ip);
+            Bytes16 hi = SimdLoad(srcHi + ip);
+            prev8 = SimdAddW(SimdPrefixSumW(SimdInterleaveLo(lo, hi)), SimdShuffle(prev8, lastWord));
+            dstPtr = ScatterWords8(dstPtr, channels, prev8);
+            prev8 = SimdAddW(SimdPrefixSumW(SimdInterleaveHi(lo, hi)), SimdShuffle(prev8, lastWord));
+            dstPtr = ScatterWords8(dstPtr, channels, prev8);
+        }
+        uint16_t prev = SimdGetLaneW<7>(prev8);
+
+        // any trailing leftover
+        for (; ip < dataElems; ++ip)
+        {
+            prev = uint16_t(prev + (srcLo[ip] | (srcHi[ip] << 8)));
+            *dstPtr = prev;
+            dstPtr += channels;
+        }
     }
-    const bool use_filter = flags & smcube_save_flag_FilterData;
-    const bool use_float16 = flags & smcube_save_flag_ConvertToFloat16;
-    const bool use_rgba = flags & smcube_save_flag_ExpandTo4Channels;
+}
 
-    for (const smcube_lut& lut : luts->luts)
+static void FilterBitShuffle(const uint8_t* src, uint8_t* dst, int channels, size_t dataElems)
+{
+    const uint16_t* srcW = (const uint16_t*)src;
+    const size_t blocks = dataElems / 16;
+    const size_t planeSize = blocks * 2;
+    for (int ich = 0; ich < channels; ++ich)
     {
-        fwrite("ALut", 1, 4, f);
-        uint64_t data_item_len = lut.channels * smcube_data_type_get_size(lut.data_type);
-        const uint64_t data_items = lut.size_x * lut.size_y * lut.size_z;
-        smcube_file_alut_header head;
-        head.channels = lut.channels;
-        head.dimension = lut.dimension;
-        head.data_type = uint32_t(lut.data_type);
-        head.filter = use_filter ? uint32_t(smcube_data_filter::ByteDelta) : uint32_t(smcube_data_filter::None);
-        head.size_x = lut.size_x;
-        head.size_y = lut.size_y;
-        head.size_z = lut.size_z;
-
-        const uint8_t* data = (const uint8_t*)lut.data;
-
-        uint8_t* data_fp16 = nullptr;
-        uint8_t* data_rgba = nullptr;
-        if (use_float16 && lut.data_type == smcube_data_type::Float32)
-        {
-            head.data_type = uint32_t(smcube_data_type::Float16);
-            data_item_len = head.channels * smcube_data_type_get_size((smcube_data_type)head.data_type);
-            data_fp16 = new uint8_t[data_item_len * data_items];
-            float_to_half((const float*)data, (uint16_t*)data_fp16, data_items * head.channels);
-            data = data_fp16;
-        }
-        if (use_rgba && head.channels == 3)
-        {
-            head.channels = 4;
-            size_t prev_data_item_len = data_item_len;
-            data_item_len = head.channels * smcube_data_type_get_size((smcube_data_type)head.data_type);
-            data_rgba = new uint8_t[data_item_len * data_items];
-            const uint8_t* src = data;
-            uint8_t* dst = data_rgba;
-            for (int i = 0; i < data_items; ++i)
+        uint8_t* dstPtr = dst + ich * 2 * dataElems;
+        Bytes16 prev8 = SimdZero();
+        for (size_t ib = 0; ib < blocks; ++ib)
+        {
+            const uint16_t* srcPtr = srcW + ib * 16 * channels + ich;
+            Bytes16 v0 = GatherWords8(srcPtr, channels);
+            Bytes16 v1 = GatherWords8(srcPtr + 8 * channels, channels);
+            uint8_t delta[32];
+            SimdStore(delta, WordDelta8(v0, prev8));
+            SimdStore(delta + 16, WordDelta8(v1, v0));
+            prev8 = v1;
+
+            // low bytes of the 16 deltas, and high bytes
+            uint8_t bytes[32];
+            memcpy(bytes, delta, 8);
+            memcpy(bytes + 8, delta + 16, 8);
+            memcpy(bytes + 16, delta + 8, 8);
+            memcpy(bytes + 24, delta + 24, 8);
+            Bytes16 lo = SimdLoad(bytes);
+            Bytes16 hi = SimdLoad(bytes + 16);
+
+            // bit planes from the top bit down: movemask gets top bits of all bytes,
+            // adding bytes to themselves shifts the next bit into the top
+            for (int bit = 7; bit >= 0; --bit)
             {
-                memcpy(dst, src, prev_data_item_len);
-                memset(dst + prev_data_item_len, 0, data_item_len - prev_data_item_len);
-                src += prev_data_item_len;
-                dst += data_item_len;
+                uint16_t maskLo = SimdMoveMask(lo);
+                uint16_t maskHi = SimdMoveMask(hi);
+                memcpy(dstPtr + bit * planeSize + ib * 2, &maskLo, 2);
+                memcpy(dstPtr + (bit + 8) * planeSize + ib * 2, &maskHi, 2);
+                lo = SimdAdd(lo, lo);
+                hi = SimdAdd(hi, hi);
             }
-            data = data_rgba;
         }
 
-        const uint64_t data_size = data_item_len * data_items;
-        const uint64_t chunk_len = sizeof(smcube_file_alut_header) + data_size;
-        fwrite(&chunk_len, sizeof(chunk_len), 1, f);
-        fwrite(&head, sizeof(head), 1, f);
+        // trailing deltas as they are
+        uint16_t prev = SimdGetLaneW<7>(prev8);
+        uint8_t* tail = dstPtr + 16 * planeSize;
+        for (size_t ip = blocks * 16; ip < dataElems; ++ip)
+        {
+            uint16_t v = srcW[ip * channels + ich];
+            uint16_t delta = uint16_t(v - prev);
+            prev = v;
+            *tail++ = uint8_t(delta);
+            *tail++ = uint8_t(delta >> 8);
+        }
+    }
+}
 
-        if (use_filter) {
-            uint8_t* filtered_data = new uint8_t[data_size];
-            FilterByteDelta(data, filtered_data, int(data_item_len), data_items);
-            fwrite(filtered_data, 1, data_size, f);
-            delete[] filtered_data;
+static void UnFilterBitShuffle(const uint8_t* src, uint8_t* dst, int channels, size_t dataElems)
+{
+    // spread 16 bit mask into 0/1 bytes: low mask byte into first 8 bytes, high into last 8, then pick one bit in each
+    static const uint8_t kSpreadMask[16] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1 };
+    static const uint8_t kMaskBits[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    const Bytes16 spread = SimdLoad(kSpreadMask);
+    const Bytes16 maskBits = SimdLoad(kMaskBits);
+    const Bytes16 one = SimdSet1(1);
+    const Bytes16 lastWord = SimdLoad(kLastWord);
+    const size_t blocks = dataElems / 16;
+    const size_t planeSize = blocks * 2;
+    for (int ich = 0; ich < channels; ++ich)
+    {
+        const uint8_t* srcPtr = src + ich * 2 * dataElems;
+        uint16_t* dstPtr = (uint16_t*)dst + ich;
+        Bytes16 prev8 = SimdZero();
+        for (size_t ib = 0; ib < blocks; ++ib)
+        {
+            // gather bit planes back into low and high bytes, from the top bit down
+            Bytes16 lo = SimdZero();
+            Bytes16 hi = SimdZero();
+            for (int bit = 7; bit >= 0; --bit)
+            {
+                uint16_t maskLo, maskHi;
+                memcpy(&maskLo, srcPtr + bit * planeSize + ib * 2, 2);
+                memcpy(&maskHi, srcPtr + (bit + 8) * planeSize + ib * 2, 2);
+                lo = SimdOr(SimdAdd(lo, lo), SimdMin(SimdAnd(SimdShuffle(SimdSet1W(maskLo), spread), maskBits), one));
+                hi = SimdOr(SimdAdd(hi, hi), SimdMin(SimdAnd(SimdShuffle(SimdSet1W(maskHi), spread), maskBits), one));
+            }
+            // interleave bytes into words, un-delta via prefix sum
+            prev8 = SimdAddW(SimdPrefixSumW(SimdInterleaveLo(lo, hi)), SimdShuffle(prev8, lastWord));
+            dstPtr = ScatterWords8(dstPtr, channels, prev8);
+            prev8 = SimdAddW(SimdPrefixSumW(SimdInterleaveHi(lo, hi)), SimdShuffle(prev8, lastWord));
+            dstPtr = ScatterWords8(dstPtr, channels, prev8);
         }
-        else {
-            fwrite(data, 1, data_size, f);
+
+        // trailing deltas
+        uint16_t prev = SimdGetLaneW<7>(prev8);
+        const uint8_t* tail = srcPtr + 16 * planeSize;
+        for (size_t ip = blocks * 16; ip < dataElems; ++ip)
+        {
+            prev = uint16_t(prev + (tail[0] | (tail[1] << 8)));
+            tail += 2;
+            *dstPtr = prev;
+            dstPtr += channels;
         }
-        delete[] data_fp16;
-        delete[] data_rgba;
     }
-
-    fclose(f);
-    return true;
 }
 
-const char* smcube_get_title(const smcube_luts* handle)
+// --------------------------------------------------------------------------
+// Tiny order-0 rANS entropy coder, see
+// https://github.com/rygorous/ryg_rans
+// https://fgiesen.wordpress.com/2014/02/02/rans-notes/
+//
+// Data is compressed as several independent byte streams (e.g. byte lanes
+// of ByteDelta filtered data), each with its own symbol frequencies. Each
+// stream is:
+// - u8: mode (0=stored, 1=rANS)
+// - stored: u8[count] data
+// - rANS: u8[32] bitmask of used symbols; varint frequency of each used
+//   symbol (they sum up to kRansScale); u32 encoded size; u8[size] data.
+
+static const uint32_t kRansScaleBits = 12;
+static const uint32_t kRansScale = 1 << kRansScaleBits;
+static const uint32_t kRansLow = 1 << 23;
+// smallest possible rANS stream: mode, symbol mask, one frequency varint,
+// encoded size and two 32-bit states
+static const size_t kRansMinStreamSize = 1 + 32 + 1 + 4 + 8;
+// upper limit of decompressed LUT data size (rANS can encode very long runs
+// of the same symbol in a handful of bytes, so payload size alone is no limit)
+static const size_t kMaxDecompressedLutSize = size_t(1) << 30;
+
+enum class rans_stream_mode : uint8_t
 {
-    if (handle == nullptr)
-        return "";
-    return handle->title.c_str();
-}
+    Stored = 0,
+    Rans,
+};
 
-const char* smcube_get_comment(const smcube_luts* handle)
+static void rans_normalize_freqs(const size_t* counts, size_t total, uint32_t* freqs)
+{
+    uint32_t sum = 0;
+    int max_sym = 0;
+    for (int s = 0; s < 256; ++s)
+    {
+        freqs[s] = counts[s] == 0 ? 0 : std::max<uint32_t>(1, uint32_t(uint64_t(counts[s]) * kRansScale / total));
+        sum += freqs[s];
+        if (freqs[s] > freqs[max_sym])
+            max_sym = s;
+    }
+    // fix up rounding errors; steal from (or give to) the most frequent
+    // symbols, keeping every used symbol at frequency one or more
+    while (sum > kRansScale)
+    {
+        int s = int(std::max_element(freqs, freqs + 256) - freqs);
+        uint32_t take = std::min(sum - kRansScale, freqs[s] / 2);
+        freqs[s] -= take;
+        sum -= take;
+    }
+    freqs[max_sym] += kRansScale - sum;
+}
+
+static void rans_write_varint(std::vector<uint8_t>& dst, uint32_t v)
+{
+    while (v >= 0x80)
+    {
+        dst.push_back(uint8_t(v | 0x80));
+        v >>= 7;
+    }
+    dst.push_back(uint8_t(v));
+}
+
+static bool rans_read_varint(const uint8_t*& src, const uint8_t* end, uint32_t& v)
+{
+    v = 0;
+    for (int shift = 0; shift < 21; shift += 7)
+    {
+        if (src >= end)
+            return false;
+        uint8_t b = *src++;
+        v |= uint32_t(b & 0x7F) << shift;
+        if (b < 0x80)
+            return true;
+    }
+    return false;
+}
+
+// Append compressed stream of count bytes to dst.
+static void rans_encode_stream(const uint8_t* src, size_t count, std::vector<uint8_t>& dst)
+{
+    size_t counts[256] = {};
+    for (size_t i = 0; i < count; ++i)
+        counts[src[i]]++;
+    uint32_t freqs[256], starts[256];
+    if (count > 0)
+        rans_normalize_freqs(counts, count, freqs);
+    else
+        memset(freqs, 0, sizeof(freqs));
+    uint32_t start = 0;
+    for (int s = 0; s < 256; ++s)
+    {
+        starts[s] = start;
+        start += freqs[s];
+    }
+
+    // rANS encodes in reverse order, into the end of a temporary buffer;
+    // a symbol takes at most 12 bits. Two interleaved states (even and odd
+    // symbols) make decoding faster.
+    std::vector<uint8_t> buf(count * 2 + 16);
+    uint8_t* end = buf.data() + buf.size();
+    uint8_t* ptr = end;
+    uint32_t states[2] = { kRansLow, kRansLow };
+    for (size_t i = count; i > 0; --i)
+    {
+        const uint8_t s = src[i - 1];
+        const uint32_t freq = freqs[s];
+        const uint32_t x_max = ((kRansLow >> kRansScaleBits) << 8) * freq;
+        uint32_t& x = states[(i - 1) & 1];
+        while (x >= x_max)
+        {
+            *--ptr = uint8_t(x & 0xFF);
+            x >>= 8;
+        }
+        x = ((x / freq) << kRansScaleBits) + (x % freq) + starts[s];
+    }
+
+    // store the data as is if it does not get smaller
+    size_t header_size = 32 + 4 + 8;
+    for (int s = 0; s < 256; ++s)
+        header_size += freqs[s] == 0 ? 0 : (freqs[s] < 0x80 ? 1 : 2);
+    if (header_size + size_t(end - ptr) >= count)
+    {
+        dst.push_back(uint8_t(rans_stream_mode::Stored));
+        dst.insert(dst.end(), src, src + count);
+        return;
+    }
+    for (int k = 1; k >= 0; --k)
+    {
+        ptr -= 4;
+        memcpy(ptr, &states[k], 4);
+    }
+
+    dst.push_back(uint8_t(rans_stream_mode::Rans));
+    uint8_t mask[32] = {};
+    for (int s = 0; s < 256; ++s)
+    {
+        if (freqs[s] != 0)
+            mask[s >> 3] |= 1 << (s & 7);
+    }
+    dst.insert(dst.end(), mask, mask + 32);
+    for (int s = 0; s < 256; ++s)
+    {
+        if (freqs[s] != 0)
+            rans_write_varint(dst, freqs[s]);
+    }
+    const uint32_t encoded_size = uint32_t(end - ptr);
+    const uint8_t* size_bytes = (const uint8_t*)&encoded_size;
+    dst.insert(dst.end(), size_bytes, size_bytes + 4);
+    dst.insert(dst.end(), ptr, end);
+}
+
+// Decode a stream of count bytes, calling sink(index, byte) for each of
+// them in order, so that whatever un-filtering needs to be done can be
+// fused into decoding. The stored stream data is given to stored(data)
+// as a whole instead. Advances src past the stream; returns false if
+// data is malformed.
+template<typename Sink, typename Stored>
+static bool rans_decode_stream(const uint8_t*& src, const uint8_t* end, size_t count, Sink sink, Stored stored)
+{
+    if (src >= end)
+        return false;
+    const uint8_t mode = *src++;
+    if (mode == uint8_t(rans_stream_mode::Stored))
+    {
+        if (size_t(end - src) < count)
+            return false;
+        stored(src);
+        src += count;
+        return true;
+    }
+    if (mode != uint8_t(rans_stream_mode::Rans) || end - src < 32)
+        return false;
+
+    // symbol frequencies into slot -> symbol table; each entry has
+    // (frequency-1) in bits 20..31, slot offset from symbol start in bits
+    // 8..19 and the symbol in bits 0..7
+    std::vector<uint32_t> slots(kRansScale);
+    const uint8_t* mask = src;
+    src += 32;
+    uint32_t start = 0;
+    for (int s = 0; s < 256; ++s)
+    {
+        if (!(mask[s >> 3] & (1 << (s & 7))))
+            continue;
+        uint32_t freq;
+        if (!rans_read_varint(src, end, freq) || freq == 0 || start + freq > kRansScale)
+            return false;
+        for (uint32_t i = 0; i < freq; ++i)
+            slots[start + i] = ((freq - 1) << 20) | (i << 8) | uint32_t(s);
+        start += freq;
+    }
+    uint32_t encoded_size;
+    if (start != kRansScale || end - src < 4)
+        return false;
+    memcpy(&encoded_size, src, 4);
+    src += 4;
+    if (encoded_size < 8 || size_t(end - src) < encoded_size)
+        return false;
+
+    const uint8_t* ptr = src;
+    const uint8_t* ptr_end = src + encoded_size;
+    uint32_t x0, x1;
+    memcpy(&x0, ptr, 4);
+    memcpy(&x1, ptr + 4, 4);
+    ptr += 8;
+    auto decode = [&](size_t i, uint32_t& x)
+    {
+        const uint32_t e = slots[x & (kRansScale - 1)];
+        sink(i, uint8_t(e));
+        x = ((e >> 20) + 1) * (x >> kRansScaleBits) + ((e >> 8) & (kRansScale - 1));
+        while (x < kRansLow)
+        {
+            if (ptr >= ptr_end)
+                return false;
+            x = (x << 8) | *ptr++;
+        }
+        return true;
+    };
+    size_t i = 0;
+    for (; i + 1 < count; i += 2)
+    {
+        if (!decode(i, x0) || !decode(i + 1, x1))
+            return false;
+    }
+    if (i < count && !decode(i, x0))
+        return false;
+    src = ptr_end;
+    return true;
+}
+
+// Compression of already filtered data, each byte lane separately.
+static void CompressLanes(const uint8_t* src, int lanes, size_t dataElems, std::vector<uint8_t>& dst)
+{
+    for (int ich = 0; ich < lanes; ++ich)
+        rans_encode_stream(src + ich * dataElems, dataElems, dst);
+}
+
+static bool DecompressLanes(const uint8_t* src, const uint8_t* end, uint8_t* dst, int lanes, size_t dataElems)
+{
+    for (int ich = 0; ich < lanes; ++ich)
+    {
+        uint8_t* dstPtr = dst + ich * dataElems;
+        bool ok = rans_decode_stream(src, end, dataElems,
+            [&](size_t i, uint8_t v) { dstPtr[i] = v; },
+            [&](const uint8_t* data) { memcpy(dstPtr, data, dataElems); });
+        if (!ok)
+            return false;
+    }
+    return src == end;
+}
+
+// Decompression fused with ByteDelta un-filtering: decoded deltas are summed
+// up and scattered into destination right away. Values are complete once
+// the last byte lane is decoded; rowDone(row) is called for each row of
+// rowElems elements while that happens.
+template<typename RowDone>
+static bool DecompressByteDelta(const uint8_t* src, const uint8_t* end, uint8_t* dst, int channels, size_t dataElems, size_t rowElems, RowDone rowDone)
+{
+    for (int ich = 0; ich < channels - 1; ++ich)
+    {
+        uint8_t prev = 0;
+        uint8_t* dstPtr = dst + ich;
+        bool ok = rans_decode_stream(src, end, dataElems,
+            [&](size_t i, uint8_t v) { prev += v; dstPtr[i * channels] = prev; },
+            [&](const uint8_t* data) { UnFilterByteDeltaLane(data, dstPtr, channels, dataElems); });
+        if (!ok)
+            return false;
+    }
+    uint8_t prev = 0;
+    uint8_t* dstPtr = dst + channels - 1;
+    size_t row = 0;
+    size_t rowEnd = rowElems - 1;
+    bool ok = rans_decode_stream(src, end, dataElems,
+        [&](size_t i, uint8_t v)
+        {
+            prev += v;
+            dstPtr[i * channels] = prev;
+            if (i == rowEnd)
+            {
+                rowDone(row++);
+                rowEnd += rowElems;
+            }
+        },
+        [&](const uint8_t* data)
+        {
+            UnFilterByteDeltaLane(data, dstPtr, channels, dataElems);
+            for (; row < dataElems / rowElems; ++row)
+                rowDone(row);
+        });
+    return ok && src == end;
+}
+
+// --------------------------------------------------------------------------
+// File parsing
+
+// chunks:
+// - u32: FOURCC
+// - u64: data_size
+// - u8[data_size]: data
+//
+// header: SML1
+// - no data
+//
+// meta title: Titl
+// - data is the title
+// meta comment: Comm
+// - data is the comment
+// padding: Padd
+// - data is zeroes; makes next LUT data start at aligned file offset
+// meta domain: Domn
+// - u32: channels (e.g. 3 for RGB)
+// - f32[channels]: min range
+// - f32[channels]: max range
+// - applies to the LUT chunk that follows it
+// LUT/image: ALut
+// - u32: channels (e.g. 3 for RGB)
+// - u32: dimension (1=1D, 2=2D, 3=3D)
+// - u32: data type (0=float)
+// - u16: filter (0=none, 1=bytedelta, 2=predict3d, 3=worddelta, 4=bitshuffle; +0x100 if difference from identity)
+// - u16: compression (0=none, 1=rans)
+// - u32x3: dimensions x, y, z
+// - data
+// - if difference from identity: exceptions (values that are stored as they
+//   are), u32[count] value indices, value[count] values, u32 count
+
+struct smcube_lut
+{
+    int channels = 3; // 3=RGB, 4=RGBA
+    int dimension = 3; // 1=1D, 2=2D, 3=3D
+    smcube_data_type data_type = smcube_data_type::Float32;
+    int size_x = 1;
+    int size_y = 1;
+    int size_z = 1;
+    float domain_min[3] = { 0.0f, 0.0f, 0.0f }; // input range minimum
+    float domain_max[3] = { 1.0f, 1.0f, 1.0f }; // input range maximum
+    void* data = nullptr;
+};
+
+static bool lut_has_default_domain(const smcube_lut& lut)
+{
+    for (int ch = 0; ch < 3; ++ch)
+    {
+        if (lut.domain_min[ch] != 0.0f || lut.domain_max[ch] != 1.0f)
+            return false;
+    }
+    return true;
+}
+
+size_t smcube_data_type_get_size(smcube_data_type type)
+{
+    switch (type) {
+    case smcube_data_type::Float32: return 4;
+    case smcube_data_type::Float16: return 2;
+    default: assert(false); return 0;
+    }
+}
+
+struct smcube_file_alut_header
+{
+    uint32_t channels;
+    uint32_t dimension;
+    uint32_t data_type;
+    uint16_t filter;
+    uint16_t compression;
+    uint32_t size_x;
+    uint32_t size_y;
+    uint32_t size_z;
+};
+static_assert(sizeof(smcube_file_alut_header) == 28, "Unexpected smcube_file_alut_header size");
+
+enum class smcube_data_filter : uint16_t
+{
+    None = 0,
+    ByteDelta,
+    Predict3D,
+    WordDelta, // Float16 data only
+    BitShuffle, // Float16 data only
+    FilterCount
+};
+
+enum class smcube_data_compression : uint16_t
+{
+    None = 0,
+    Rans, // built-in rANS coder, only with filtered data
+    CompressionCount
+};
+
+// Filter field of smcube_file_alut_header: lower bits are smcube_data_filter,
+// plus a bit if data is stored as difference from identity LUT.
+static const uint16_t kFilterTypeMask = 0xFF;
+static const uint16_t kFilterIdentityResidual = 0x100;
+
+static void lut_get_filter_sizes(const smcube_lut& lut, int& size_x, int& size_y, int& size_z)
+{
+    size_x = lut.size_x;
+    size_y = lut.dimension >= 2 ? lut.size_y : 1;
+    size_z = lut.dimension >= 3 ? lut.size_z : 1;
+}
+
+// Filters LUT data (in its data type and channel count) into byte lanes.
+static void lut_filter_data(smcube_data_filter filter, const smcube_lut& lut, const uint8_t* src, uint8_t* dst)
+{
+    const int type_size = int(smcube_data_type_get_size(lut.data_type));
+    int size_x, size_y, size_z;
+    lut_get_filter_sizes(lut, size_x, size_y, size_z);
+    if (filter == smcube_data_filter::ByteDelta)
+        FilterByteDelta(src, dst, type_size * lut.channels, size_t(size_x) * size_y * size_z);
+    else if (filter == smcube_data_filter::Predict3D)
+        FilterPredict3D(src, dst, type_size, lut.channels, size_x, size_y, size_z);
+    else if (filter == smcube_data_filter::WordDelta)
+        FilterWordDelta(src, dst, lut.channels, size_t(size_x) * size_y * size_z);
+    else if (filter == smcube_data_filter::BitShuffle)
+        FilterBitShuffle(src, dst, lut.channels, size_t(size_x) * size_y * size_z);
+}
+
+static void lut_unfilter_data(smcube_data_filter filter, const smcube_lut& lut, const uint8_t* src, uint8_t* dst)
+{
+    const int type_size = int(smcube_data_type_get_size(lut.data_type));
+    int size_x, size_y, size_z;
+    lut_get_filter_sizes(lut, size_x, size_y, size_z);
+    if (filter == smcube_data_filter::ByteDelta)
+        UnFilterByteDelta(src, dst, type_size * lut.channels, size_t(size_x) * size_y * size_z);
+    else if (filter == smcube_data_filter::Predict3D)
+        UnFilterPredict3D(src, dst, type_size, lut.channels, size_x, size_y, size_z, [](size_t) {});
+    else if (filter == smcube_data_filter::WordDelta)
+        UnFilterWordDelta(src, dst, lut.channels, size_t(size_x) * size_y * size_z);
+    else if (filter == smcube_data_filter::BitShuffle)
+        UnFilterBitShuffle(src, dst, lut.channels, size_t(size_x) * size_y * size_z);
+}
+
+template<bool Add>
+static void IdentityRow(const float* src, const float* ident, float* dst, size_t count)
+{
+    size_t i = 0;
+    for (; i + 3 < count; i += 4)
+    {
+        Float4 v = SimdLoadF(src + i);
+        Float4 id = SimdLoadF(ident + i);
+        SimdStoreF(dst + i, Add ? SimdAddF(v, id) : SimdSubF(v, id));
+    }
+    for (; i < count; ++i)
+        dst[i] = Add ? src[i] + ident[i] : src[i] - ident[i];
+}
+
+// Identity LUT values (output equal to input within LUT domain), one row
+// along X at a time. Channel N of 2D/3D LUTs changes along axis N, all
+// channels of 1D LUTs change along X; other channels (alpha) are zero.
+// Values are calculated in double precision, where the products are exact,
+// so that they are the same on all platforms regardless of FMA use.
+struct lut_identity_rows
+{
+    explicit lut_identity_rows(const smcube_lut& lut)
+    {
+        int sizes[3];
+        lut_get_filter_sizes(lut, sizes[0], sizes[1], sizes[2]);
+        size_x = sizes[0];
+        channels = lut.channels;
+        for (int ch = 0; ch < channels; ++ch)
+        {
+            if (ch >= 3)
+                axis[ch] = -1;
+            else if (lut.dimension == 1)
+                axis[ch] = 0;
+            else
+                axis[ch] = ch < lut.dimension ? ch : -1;
+            if (axis[ch] < 0)
+                continue;
+            const int size = sizes[axis[ch]];
+            axis_values[ch].resize(size);
+            for (int i = 0; i < size; ++i)
+            {
+                axis_values[ch][i] = size < 2 ? lut.domain_min[ch] :
+                    float((double(lut.domain_min[ch]) * (size - 1 - i) + double(lut.domain_max[ch]) * i) / (size - 1));
+            }
+        }
+        size_y = sizes[1];
+        half = lut.data_type == smcube_data_type::Float16;
+        row.resize(size_t(size_x) * channels, 0.0f);
+        if (half)
+            tmp.resize(row.size());
+        for (int x = 0; x < size_x; ++x)
+        {
+            for (int ch = 0; ch < channels; ++ch)
+                if (axis[ch] == 0)
+                    row[x * channels + ch] = axis_values[ch][x];
+        }
+    }
+
+    void set_row(int y, int z)
+    {
+        for (int ch = 0; ch < channels; ++ch)
+        {
+            if (axis[ch] <= 0)
+                continue;
+            const float v = axis_values[ch][axis[ch] == 1 ? y : z];
+            for (int x = 0; x < size_x; ++x)
+                row[x * channels + ch] = v;
+        }
+    }
+
+    size_t row_size() const { return row.size() * (half ? 2 : 4); }
+
+    // Adds (or subtracts) identity to one row of LUT data; row_index is
+    // y + z * size_y. src and dst can be the same. Half data is converted
+    // to floats and back.
+    template<bool Add>
+    void apply_row(const uint8_t* src, uint8_t* dst, size_t row_index)
+    {
+        set_row(int(row_index % size_y), int(row_index / size_y));
+        if (half)
+        {
+            half_to_float((const uint16_t*)src, tmp.data(), row.size());
+            IdentityRow<Add>(tmp.data(), row.data(), tmp.data(), row.size());
+            float_to_half(tmp.data(), (uint16_t*)dst, row.size());
+        }
+        else
+        {
+            IdentityRow<Add>((const float*)src, row.data(), (float*)dst, row.size());
+        }
+    }
+
+    int size_x;
+    int size_y;
+    int channels;
+    bool half;
+    int axis[4];
+    std::vector<float> axis_values[4];
+    std::vector<float> row;
+    std::vector<float> tmp;
+};
+
+// Adds (or subtracts) identity LUT values to LUT data; src and dst can be the same.
+template<bool Add>
+static void lut_apply_identity(const smcube_lut& lut, const uint8_t* src, uint8_t* dst)
+{
+    lut_identity_rows ident(lut);
+    int size_x, size_y, size_z;
+    lut_get_filter_sizes(lut, size_x, size_y, size_z);
+    const size_t row_size = ident.row_size();
+    const size_t rows = size_t(size_y) * size_z;
+    for (size_t r = 0; r < rows; ++r)
+        ident.apply_row<Add>(src + r * row_size, dst + r * row_size, r);
+}
+
+// Calculates difference from identity LUT. Indices of values where adding
+// identity back would not exactly reproduce the data (e.g. values much
+// smaller than identity values) are put into exceptions; these values are
+// stored as they are.
+static void lut_subtract_identity(const smcube_lut& lut, const uint8_t* src, uint8_t* dst, std::vector<uint32_t>& exceptions)
+{
+    int size_x, size_y, size_z;
+    lut_get_filter_sizes(lut, size_x, size_y, size_z);
+    const size_t value_size = smcube_data_type_get_size(lut.data_type);
+    const size_t value_count = size_t(size_x) * size_y * size_z * lut.channels;
+    lut_apply_identity<false>(lut, src, dst);
+    std::vector<uint8_t> check(value_count * value_size);
+    lut_apply_identity<true>(lut, dst, check.data());
+    exceptions.clear();
+    if (memcmp(check.data(), src, check.size()) == 0)
+        return;
+    for (size_t i = 0; i < value_count; ++i)
+    {
+        if (memcmp(check.data() + i * value_size, src + i * value_size, value_size) != 0)
+            exceptions.push_back(uint32_t(i));
+    }
+}
+
+// Puts exception values of identity residual data (stored at the end of LUT
+// payload) in place, after identity was added back. Returns false if
+// exception data is invalid.
+static bool lut_put_identity_exceptions(const smcube_lut& lut, uint8_t* dst, const uint8_t* exceptions, uint32_t exception_count)
+{
+    int size_x, size_y, size_z;
+    lut_get_filter_sizes(lut, size_x, size_y, size_z);
+    const size_t value_size = smcube_data_type_get_size(lut.data_type);
+    const size_t value_count = size_t(size_x) * size_y * size_z * lut.channels;
+    const uint8_t* values = exceptions + exception_count * sizeof(uint32_t);
+    for (uint32_t i = 0; i < exception_count; ++i)
+    {
+        uint32_t index;
+        memcpy(&index, exceptions + i * sizeof(uint32_t), sizeof(index));
+        if (index >= value_count)
+            return false;
+        memcpy(dst + index * value_size, values + i * value_size, value_size);
+    }
+    return true;
+}
+
+// Decompresses rANS compressed LUT data into lut.data and un-filters it.
+// rowDone(row) is called for each row (along X) once it is final; ByteDelta
+// and Predict3D do that while decoding, so that e.g. identity can be added
+// back to rows while they are still in cache.
+template<typename RowDone>
+static bool lut_decompress_data(smcube_data_filter filter, const smcube_lut& lut, const uint8_t* src, const uint8_t* end, RowDone rowDone)
+{
+    const int type_size = int(smcube_data_type_get_size(lut.data_type));
+    int size_x, size_y, size_z;
+    lut_get_filter_sizes(lut, size_x, size_y, size_z);
+    const int item_size = type_size * lut.channels;
+    const size_t item_count = size_t(size_x) * size_y * size_z;
+    uint8_t* dst = (uint8_t*)lut.data;
+    if (filter == smcube_data_filter::ByteDelta)
+        return DecompressByteDelta(src, end, dst, item_size, item_count, size_t(size_x), rowDone);
+    std::vector<uint8_t> lanes(item_count * item_size);
+    if (!DecompressLanes(src, end, lanes.data(), item_size, item_count))
+        return false;
+    if (filter == smcube_data_filter::Predict3D)
+    {
+        UnFilterPredict3D(lanes.data(), dst, type_size, lut.channels, size_x, size_y, size_z, rowDone);
+        return true;
+    }
+    lut_unfilter_data(filter, lut, lanes.data(), dst);
+    for (size_t row = 0; row < size_t(size_y) * size_z; ++row)
+        rowDone(row);
+    return true;
+}
+
+// Adds identity LUT values back to LUT data, and puts exception values in place.
+static bool lut_add_identity(const smcube_lut& lut, const uint8_t* src, uint8_t* dst, const uint8_t* exceptions, uint32_t exception_count)
+{
+    lut_apply_identity<true>(lut, src, dst);
+    return lut_put_identity_exceptions(lut, dst, exceptions, exception_count);
+}
+
+// File data (and other LUT data storage) is allocated aligned, so that data
+// of files saved with alignment flags is aligned in memory too.
+static const size_t kFileDataAlignment = 64;
+
+static uint8_t* alloc_file_data(size_t size)
+{
+    return new (std::align_val_t(kFileDataAlignment)) uint8_t[size];
+}
+
+static void free_file_data(uint8_t* data)
+{
+    ::operator delete[](data, std::align_val_t(kFileDataAlignment));
+}
+
+struct smcube_luts
+{
+    uint8_t* file_data = nullptr;
+    size_t file_data_size = 0;
+    std::string title;
+    std::string comment;
+    std::vector<smcube_lut> luts;
+    std::vector<uint8_t*> decompressed_data; // data of compressed LUT chunks, from alloc_file_data
+};
+
+// Prepare LUT data the way it is stored in the file: converted to the
+// requested data type and channel count, filtered and compressed.
+static void lut_encode_for_file(const smcube_lut& lut, smcube_save_flags flags, smcube_file_alut_header& head, std::vector<uint8_t>& payload)
+{
+    const bool use_compression = flags & smcube_save_flag_Compress;
+    const bool use_predict = flags & smcube_save_flag_FilterPredict3D;
+    const bool use_word_delta = flags & smcube_save_flag_FilterWordDelta;
+    const bool use_bit_shuffle = flags & smcube_save_flag_FilterBitShuffle;
+    const bool use_filter = use_compression || use_predict || use_word_delta || use_bit_shuffle || (flags & smcube_save_flag_FilterData);
+    const bool use_float16 = flags & smcube_save_flag_ConvertToFloat16;
+    const bool use_rgba = flags & smcube_save_flag_ExpandTo4Channels;
+    const bool use_identity = flags & smcube_save_flag_IdentityResidual;
+
+    uint64_t data_item_len = lut.channels * smcube_data_type_get_size(lut.data_type);
+    const uint64_t data_items = lut.size_x * lut.size_y * lut.size_z;
+    head.channels = lut.channels;
+    head.dimension = lut.dimension;
+    head.data_type = uint32_t(lut.data_type);
+    head.compression = uint16_t(use_compression ? smcube_data_compression::Rans : smcube_data_compression::None);
+    head.size_x = lut.size_x;
+    head.size_y = lut.size_y;
+    head.size_z = lut.size_z;
+
+    const uint8_t* data = (const uint8_t*)lut.data;
+
+    uint8_t* data_fp16 = nullptr;
+    uint8_t* data_rgba = nullptr;
+    if (use_float16 && lut.data_type == smcube_data_type::Float32)
+    {
+        head.data_type = uint32_t(smcube_data_type::Float16);
+        data_item_len = head.channels * smcube_data_type_get_size((smcube_data_type)head.data_type);
+        data_fp16 = new uint8_t[data_item_len * data_items];
+        float_to_half((const float*)data, (uint16_t*)data_fp16, data_items * head.channels);
+        data = data_fp16;
+    }
+    if (use_rgba && head.channels == 3)
+    {
+        head.channels = 4;
+        size_t prev_data_item_len = data_item_len;
+        data_item_len = head.channels * smcube_data_type_get_size((smcube_data_type)head.data_type);
+        data_rgba = new uint8_t[data_item_len * data_items];
+        const uint8_t* src = data;
+        uint8_t* dst = data_rgba;
+        for (int i = 0; i < data_items; ++i)
+        {
+            memcpy(dst, src, prev_data_item_len);
+            memset(dst + prev_data_item_len, 0, data_item_len - prev_data_item_len);
+            src += prev_data_item_len;
+            dst += data_item_len;
+        }
+        data = data_rgba;
+    }
+
+    // word based filters are only for Float16 data, ByteDelta is used otherwise
+    const bool is_half = head.data_type == uint32_t(smcube_data_type::Float16);
+    smcube_data_filter filter = smcube_data_filter::None;
+    if (use_predict)
+        filter = smcube_data_filter::Predict3D;
+    else if (use_word_delta && is_half)
+        filter = smcube_data_filter::WordDelta;
+    else if (use_bit_shuffle && is_half)
+        filter = smcube_data_filter::BitShuffle;
+    else if (use_filter)
+        filter = smcube_data_filter::ByteDelta;
+    head.filter = uint16_t(filter);
+
+    const uint64_t data_size = data_item_len * data_items;
+    smcube_lut layout = lut;
+    layout.data_type = smcube_data_type(head.data_type);
+    layout.channels = head.channels;
+
+    // store difference from identity; values that would not be reproduced
+    // exactly are stored as they are after LUT data
+    std::vector<uint8_t> data_residual;
+    std::vector<uint32_t> exceptions;
+    const uint8_t* data_values = data;
+    if (use_identity)
+    {
+        data_residual.resize(data_size);
+        lut_subtract_identity(layout, data, data_residual.data(), exceptions);
+        head.filter |= kFilterIdentityResidual;
+        data = data_residual.data();
+    }
+
+    if (filter == smcube_data_filter::None)
+        payload.assign(data, data + data_size);
+    else
+    {
+        std::vector<uint8_t> filtered(data_size);
+        lut_filter_data(filter, layout, data, filtered.data());
+        if (use_compression)
+            CompressLanes(filtered.data(), int(data_item_len), data_items, payload);
+        else
+            payload = std::move(filtered);
+    }
+    if (use_identity)
+    {
+        const size_t value_size = smcube_data_type_get_size((smcube_data_type)head.data_type);
+        const uint32_t exception_count = uint32_t(exceptions.size());
+        const uint8_t* count_ptr = (const uint8_t*)&exception_count;
+        payload.insert(payload.end(), (const uint8_t*)exceptions.data(), (const uint8_t*)(exceptions.data() + exceptions.size()));
+        for (uint32_t index : exceptions)
+            payload.insert(payload.end(), data_values + index * value_size, data_values + (index + 1) * value_size);
+        payload.insert(payload.end(), count_ptr, count_ptr + sizeof(exception_count));
+    }
+    delete[] data_fp16;
+    delete[] data_rgba;
+}
+
+// Size of padding chunk needed before a LUT chunk at given file offset, so
+// that LUT data starts at an aligned offset. Compressed LUT data is not used
+// in place, so it is not aligned.
+static size_t lut_get_padding_size(size_t offset, smcube_save_flags flags)
+{
+    size_t alignment = 0;
+    if (flags & smcube_save_flag_AlignData64)
+        alignment = 64;
+    if (flags & smcube_save_flag_AlignDataPage)
+        alignment = 4096;
+    if (alignment == 0 || (flags & smcube_save_flag_Compress))
+        return 0;
+    size_t padding = (alignment - (offset + 12 + sizeof(smcube_file_alut_header)) % alignment) % alignment;
+    if (padding != 0 && padding < 12)
+        padding += alignment; // padding chunk needs room for its header
+    return padding;
+}
+
+bool smcube_save_to_file_smcube(const char* path, const smcube_luts* luts, smcube_save_flags flags)
+{
+    if (path == nullptr || luts == nullptr)
+        return false;
+
+    FILE* f = fopen(path, "wb");
+    if (f == nullptr)
+        return false;
+
+    fwrite("SML1", 1, 4, f);
+    size_t offset = 4;
+    if (!luts->title.empty())
+    {
+        uint64_t len = luts->title.size();
+        fwrite("Titl", 1, 4, f);
+        fwrite(&len, sizeof(len), 1, f);
+        fwrite(luts->title.data(), 1, len, f);
+        offset += 12 + len;
+    }
+    if (!luts->comment.empty())
+    {
+        uint64_t len = luts->comment.size();
+        fwrite("Comm", 1, 4, f);
+        fwrite(&len, sizeof(len), 1, f);
+        fwrite(luts->comment.data(), 1, len, f);
+        offset += 12 + len;
+    }
+    for (const smcube_lut& lut : luts->luts)
+    {
+        if (!lut_has_default_domain(lut))
+        {
+            const uint32_t domain_channels = 3;
+            const uint64_t domain_len = sizeof(domain_channels) + sizeof(lut.domain_min) + sizeof(lut.domain_max);
+            fwrite("Domn", 1, 4, f);
+            fwrite(&domain_len, sizeof(domain_len), 1, f);
+            fwrite(&domain_channels, sizeof(domain_channels), 1, f);
+            fwrite(lut.domain_min, sizeof(lut.domain_min), 1, f);
+            fwrite(lut.domain_max, sizeof(lut.domain_max), 1, f);
+            offset += 12 + domain_len;
+        }
+
+        const size_t padding = lut_get_padding_size(offset, flags);
+        if (padding != 0)
+        {
+            const uint64_t pad_len = padding - 12;
+            const std::vector<uint8_t> zeroes(pad_len, 0);
+            fwrite("Padd", 1, 4, f);
+            fwrite(&pad_len, sizeof(pad_len), 1, f);
+            fwrite(zeroes.data(), 1, zeroes.size(), f);
+            offset += padding;
+        }
+
+        smcube_file_alut_header head;
+        std::vector<uint8_t> payload;
+        lut_encode_for_file(lut, flags, head, payload);
+        const uint64_t chunk_len = sizeof(smcube_file_alut_header) + payload.size();
+        fwrite("ALut", 1, 4, f);
+        fwrite(&chunk_len, sizeof(chunk_len), 1, f);
+        fwrite(&head, sizeof(head), 1, f);
+        fwrite(payload.data(), 1, payload.size(), f);
+        offset += 12 + chunk_len;
+    }
+
+    fclose(f);
+    return true;
+}
+
+const char* smcube_get_title(const smcube_luts* handle)
+{
+    if (handle == nullptr)
+        return "";
+    return handle->title.c_str();
+}
+
+const char* smcube_get_comment(const smcube_luts* handle)
 {
     if (handle == nullptr)
         return "";
     return handle->comment.c_str();
 }
 
-size_t smcube_get_count(const smcube_luts* handle)
+size_t smcube_get_count(const smcube_luts* handle)
+{
+    if (handle == nullptr)
+        return 0;
+    return handle->luts.size();
+}
+
+smcube_lut smcube_get_lut(const smcube_luts* handle, size_t index)
+{
+    if (handle == nullptr || index >= handle->luts.size())
+        return smcube_lut();
+    return handle->luts[index];
+}
+
+int smcube_lut_get_channels(const smcube_luts* handle, size_t index)
+{
+    if (handle == nullptr || index >= handle->luts.size())
+        return 0;
+    return handle->luts[index].channels;
+}
+int smcube_lut_get_dimension(const smcube_luts* handle, size_t index)
+{
+    if (handle == nullptr || index >= handle->luts.size())
+        return 0;
+    return handle->luts[index].dimension;
+}
+smcube_data_type smcube_lut_get_data_type(const smcube_luts* handle, size_t index)
+{
+    if (handle == nullptr || index >= handle->luts.size())
+        return smcube_data_type::Float32;
+    return handle->luts[index].data_type;
+}
+int smcube_lut_get_size_x(const smcube_luts* handle, size_t index)
+{
+    if (handle == nullptr || index >= handle->luts.size())
+        return 0;
+    return handle->luts[index].size_x;
+}
+int smcube_lut_get_size_y(const smcube_luts* handle, size_t index)
+{
+    if (handle == nullptr || index >= handle->luts.size())
+        return 0;
+    return handle->luts[index].size_y;
+}
+int smcube_lut_get_size_z(const smcube_luts* handle, size_t index)
+{
+    if (handle == nullptr || index >= handle->luts.size())
+        return 0;
+    return handle->luts[index].size_z;
+}
+const void* smcube_lut_get_data(const smcube_luts* handle, size_t index)
+{
+    if (handle == nullptr || index >= handle->luts.size())
+        return 0;
+    return handle->luts[index].data;
+}
+
+static size_t lut_get_data_size(const smcube_lut& lut)
+{
+    size_t item_size = smcube_data_type_get_size(lut.data_type) * lut.channels;
+    size_t item_count = 1;
+    if (lut.dimension >= 1) item_count *= lut.size_x;
+    if (lut.dimension >= 2) item_count *= lut.size_y;
+    if (lut.dimension >= 3) item_count *= lut.size_z;
+    return item_count * item_size;
+}
+
+size_t smcube_lut_get_data_size(const smcube_luts* handle, size_t index)
+{
+    if (handle == nullptr || index >= handle->luts.size())
+        return 0;
+    return lut_get_data_size(handle->luts[index]);
+}
+
+size_t smcube_calc_file_size_smcube(const smcube_luts* luts, smcube_save_flags flags)
+{
+    if (luts == nullptr)
+        return 0;
+    size_t size = 4;
+    if (!luts->title.empty())
+        size += 12 + luts->title.size();
+    if (!luts->comment.empty())
+        size += 12 + luts->comment.size();
+    for (const smcube_lut& lut : luts->luts)
+    {
+        if (!lut_has_default_domain(lut))
+            size += 12 + sizeof(uint32_t) + sizeof(lut.domain_min) + sizeof(lut.domain_max);
+        size += lut_get_padding_size(size, flags);
+        smcube_lut saved = lut;
+        if ((flags & smcube_save_flag_ConvertToFloat16) && saved.data_type == smcube_data_type::Float32)
+            saved.data_type = smcube_data_type::Float16;
+        if ((flags & smcube_save_flag_ExpandTo4Channels) && saved.channels == 3)
+            saved.channels = 4;
+        size_t data_size = lut_get_data_size(saved);
+        if (flags & (smcube_save_flag_Compress | smcube_save_flag_IdentityResidual))
+        {
+            // compressed size and identity exception count are only known
+            // by doing the encoding
+            smcube_file_alut_header head;
+            std::vector<uint8_t> payload;
+            lut_encode_for_file(lut, flags, head, payload);
+            data_size = payload.size();
+        }
+        size += 12 + sizeof(smcube_file_alut_header) + data_size;
+    }
+    return size;
+}
+
+static bool str_ends_with(const char* str, const char* suffix)
+{
+    size_t str_len = strlen(str);
+    size_t suffix_len = strlen(suffix);
+    if (suffix_len > str_len)
+        return false;
+    return memcmp(str + str_len - suffix_len, suffix, suffix_len) == 0;
+}
+
+smcube_luts* smcube_load_from_file(const char* path)
+{
+    if (str_ends_with(path, ".cube"))
+        return smcube_load_from_file_resolve_cube(path);
+    if (str_ends_with(path, ".smcube"))
+        return smcube_load_from_file_smcube(path);
+    return nullptr;
+}
+
+smcube_luts* smcube_load_from_file_smcube(const char* path)
+{
+    if (path == nullptr)
+        return nullptr;
+
+    FILE* f = fopen(path, "rb");
+    if (f == nullptr)
+        return nullptr;
+
+    fseek(f, 0, SEEK_END);
+    int file_size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (file_size < 4)
+    {
+        fclose(f);
+        return nullptr;
+    }
+
+    smcube_luts* luts = new smcube_luts();
+    luts->file_data_size = file_size;
+    luts->file_data = alloc_file_data(file_size);
+    fread(luts->file_data, 1, file_size, f);
+    fclose(f);
+
+    if (memcmp(luts->file_data, "SML1", 4) != 0)
+    {
+        smcube_free(luts);
+        return nullptr;
+    }
+    // parse chunks
+    size_t offset = 4;
+    smcube_lut next_domain; // domain for the next LUT chunk
+    while (offset + 12 < luts->file_data_size)
+    {
+        // get and validate chunk length
+        uint64_t chunk_len;
+        memcpy(&chunk_len, luts->file_data + offset + 4, 8);
+        if (offset + 12 + chunk_len > luts->file_data_size)
+        {
+            smcube_free(luts);
+            return nullptr;
+        }
+        if (memcmp(luts->file_data + offset, "Titl", 4) == 0 && chunk_len > 0)
+        {
+            const char* str_ptr = (const char*)luts->file_data + offset + 12;
+            luts->title = std::string(str_ptr, str_ptr + chunk_len);
+        }
+        if (memcmp(luts->file_data + offset, "Comm", 4) == 0 && chunk_len > 0)
+        {
+            const char* str_ptr = (const char*)luts->file_data + offset + 12;
+            luts->comment = std::string(str_ptr, str_ptr + chunk_len);
+        }
+        if (memcmp(luts->file_data + offset, "Domn", 4) == 0 && chunk_len >= 4)
+        {
+            uint32_t domain_channels;
+            memcpy(&domain_channels, luts->file_data + offset + 12, 4);
+            if (domain_channels < 1 || domain_channels > 4 || chunk_len != 4 + domain_channels * 8)
+            {
+                smcube_free(luts);
+                return nullptr;
+            }
+            const float* domain_data = (const float*)(luts->file_data + offset + 16);
+            for (uint32_t ch = 0; ch < domain_channels && ch < 3; ++ch)
+            {
+                memcpy(&next_domain.domain_min[ch], domain_data + ch, 4);
+                memcpy(&next_domain.domain_max[ch], domain_data + domain_channels + ch, 4);
+            }
+        }
+        if (memcmp(luts->file_data + offset, "ALut", 4) == 0 && chunk_len > sizeof(smcube_file_alut_header))
+        {
+            smcube_file_alut_header head;
+            memcpy(&head, luts->file_data + offset + 12, sizeof(head));
+
+            // validate lut header
+            if (head.channels < 1 || head.channels > 4 ||
+                head.dimension < 1 || head.dimension > 3 ||
+                head.data_type >= uint32_t(smcube_data_type::DataTypeCount) ||
+                (head.filter & kFilterTypeMask) >= uint16_t(smcube_data_filter::FilterCount) ||
+                (head.filter & ~(kFilterTypeMask | kFilterIdentityResidual)) != 0 ||
+                (((head.filter & kFilterTypeMask) == uint16_t(smcube_data_filter::WordDelta) || (head.filter & kFilterTypeMask) == uint16_t(smcube_data_filter::BitShuffle)) && head.data_type != uint32_t(smcube_data_type::Float16)) ||
+                head.compression >= uint16_t(smcube_data_compression::CompressionCount) ||
+                (head.compression == uint16_t(smcube_data_compression::Rans) && (head.filter & kFilterTypeMask) == uint16_t(smcube_data_filter::None)) ||
+                head.size_x > 65536 || head.size_y > 65536 || head.size_z > 65536)
+            {
+                smcube_free(luts);
+                return nullptr;
+            }
+
+            smcube_lut lut = next_domain;
+            next_domain = smcube_lut();
+            lut.channels = head.channels;
+            lut.dimension = head.dimension;
+            lut.data_type = smcube_data_type(head.data_type);
+            lut.size_x = head.size_x;
+            lut.size_y = head.size_y;
+            lut.size_z = head.size_z;
+            size_t lut_data_size = lut_get_data_size(lut);
+            const uint8_t* payload = luts->file_data + offset + 12 + sizeof(smcube_file_alut_header);
+            size_t payload_size = chunk_len - sizeof(smcube_file_alut_header);
+            const smcube_data_filter filter = smcube_data_filter(head.filter & kFilterTypeMask);
+            const bool identity = (head.filter & kFilterIdentityResidual) != 0;
+
+            // identity residual data is followed by exception values, and their count
+            const uint8_t* exceptions = nullptr;
+            uint32_t exception_count = 0;
+            if (identity)
+            {
+                const size_t exception_size = sizeof(uint32_t) + smcube_data_type_get_size(lut.data_type);
+                bool valid = payload_size >= sizeof(exception_count);
+                if (valid)
+                {
+                    payload_size -= sizeof(exception_count);
+                    memcpy(&exception_count, payload + payload_size, sizeof(exception_count));
+                    valid = payload_size / exception_size >= exception_count;
+                }
+                if (!valid)
+                {
+                    smcube_free(luts);
+                    return nullptr;
+                }
+                payload_size -= exception_count * exception_size;
+                exceptions = payload + payload_size;
+            }
+            if (head.compression == uint16_t(smcube_data_compression::Rans))
+            {
+                // decompress into separate memory; for ByteDelta un-filtering is done in the same
+                // go, and identity is added back to each row as soon as it is final
+                size_t lut_item_size = smcube_data_type_get_size(lut.data_type) * lut.channels;
+                size_t lut_item_count = lut_data_size / lut_item_size;
+
+                // each lane stream needs at least a mode byte and either the stored
+                // data or the rANS symbol mask, frequencies, size and state; reject
+                // payloads that can't possibly hold that, or claim an unreasonably
+                // large decoded size, before allocating anything
+                if (payload_size / lut_item_size < std::min<size_t>(lut_item_count + 1, kRansMinStreamSize) ||
+                    lut_data_size > kMaxDecompressedLutSize)
+                {
+                    smcube_free(luts);
+                    return nullptr;
+                }
+                bool ok;
+                try
+                {
+                    luts->decompressed_data.push_back(nullptr);
+                    luts->decompressed_data.back() = alloc_file_data(lut_data_size);
+                    lut.data = luts->decompressed_data.back();
+                    uint8_t* data = (uint8_t*)lut.data;
+                    if (identity)
+                    {
+                        lut_identity_rows ident(lut);
+                        const size_t row_size = ident.row_size();
+                        ok = lut_decompress_data(filter, lut, payload, payload + payload_size,
+                            [&](size_t row) { ident.apply_row<true>(data + row * row_size, data + row * row_size, row); });
+                        ok = ok && lut_put_identity_exceptions(lut, data, exceptions, exception_count);
+                    }
+                    else
+                    {
+                        ok = lut_decompress_data(filter, lut, payload, payload + payload_size, [](size_t) {});
+                    }
+                }
+                catch (const std::bad_alloc&)
+                {
+                    ok = false; // header claims a size we can't allocate
+                }
+                if (!ok)
+                {
+                    smcube_free(luts);
+                    return nullptr;
+                }
+                luts->luts.push_back(lut);
+                offset += 12 + chunk_len;
+                continue;
+            }
+            if (payload_size != lut_data_size)
+            {
+                smcube_free(luts);
+                return nullptr;
+            }
+
+            // point to file data
+            lut.data = luts->file_data + offset + 12 + sizeof(smcube_file_alut_header);
+
+            // un-filter data if needed; identity is added back while copying
+            // un-filtered data into place
+            bool ok = true;
+            if (filter != smcube_data_filter::None)
+            {
+                uint8_t* tmp = new uint8_t[lut_data_size];
+                lut_unfilter_data(filter, lut, (const uint8_t*)lut.data, tmp);
+                if (identity)
+                    ok = lut_add_identity(lut, tmp, (uint8_t*)lut.data, exceptions, exception_count);
+                else
+                    memcpy(lut.data, tmp, lut_data_size);
+                delete[] tmp;
+            }
+            else if (identity)
+                ok = lut_add_identity(lut, (const uint8_t*)lut.data, (uint8_t*)lut.data, exceptions, exception_count);
+            if (!ok)
+            {
+                smcube_free(luts);
+                return nullptr;
+            }
+
+            // append to luts array
+            luts->luts.push_back(lut);
+        }
+
+        offset += 12 + chunk_len;
+    }
+
+    return luts;
+}
+
+void smcube_free(smcube_luts* handle)
+{
+    if (handle)
+    {
+        free_file_data(handle->file_data);
+        for (uint8_t* data : handle->decompressed_data)
+            free_file_data(data);
+    }
+    delete handle;
+}
+
+#if !defined(NO_FLOAT_FROM_CHARS_HERE)
+static inline bool is_whitespace(char c)
+{
+    return c <= ' ';
+}
+
+static const char* skip_whitespace(const char* p, const char* end)
+{
+    while (p < end && is_whitespace(*p))
+        ++p;
+    return p;
+}
+
+static const char* skip_plus(const char* p, const char* end)
+{
+    if (p < end && *p == '+')
+        ++p;
+    return p;
+}
+
+static const char* parse_float(const char* p, const char* end, float fallback, float& dst, bool& valid)
+{
+    p = skip_whitespace(p, end);
+    p = skip_plus(p, end);
+    std::from_chars_result res = std::from_chars(p, end, dst);
+    if (res.ec == std::errc::invalid_argument || res.ec == std::errc::result_out_of_range) {
+        dst = fallback;
+        valid = false;
+    }
+    else if (res.ptr < end && !is_whitespace(*res.ptr)) {
+        // If there are trailing non-space characters, it is not a valid number
+        dst = fallback;
+        valid = false;
+        return p;
+    }
+    return res.ptr;
+}
+
+static bool parse_3floats(const char* p, const char* end, float* dst)
+{
+    bool valid = true;
+    for (int i = 0; i < 3; ++i)
+        p = parse_float(p, end, 0.0f, dst[i], valid);
+    return valid;
+}
+
+#else
+
+static bool parse_3floats(const char* p, const char* end, float* dst)
+{
+    int count = sscanf(p, "%f %f %f", dst+0, dst+1, dst+2);
+    return count == 3;
+}
+
+#endif
+
+
+// Resolve .cube file format notes:
+// https://resolve.cafe/developers/luts/
+
+smcube_luts* smcube_load_from_file_resolve_cube(const char* path)
+{
+    if (path == nullptr)
+        return nullptr;
+
+    FILE* f = fopen(path, "rb");
+    if (f == nullptr)
+        return nullptr;
+
+    char buf[1000] = {};
+    std::string title;
+
+    // read header
+    int dim_3d = 0, dim_1d = 0;
+    smcube_lut domain_1d, domain_3d;
+    while (true) {
+        char* res = fgets(buf, sizeof(buf)-1, f);
+        if (!res)
+            break;
+        if (buf[0] >= '+' && buf[0] <= '9') // line starts with a number: header is done
+            break;
+        int tmp;
+        if (1 == sscanf(buf, "LUT_1D_SIZE %i", &tmp))
+        {
+            dim_1d = tmp;
+        }
+        if (1 == sscanf(buf, "LUT_3D_SIZE %i", &tmp))
+        {
+            dim_3d = tmp;
+        }
+        float range[3];
+        if (2 == sscanf(buf, "LUT_1D_INPUT_RANGE %f %f", &range[0], &range[1]))
+        {
+            for (int ch = 0; ch < 3; ++ch)
+            {
+                domain_1d.domain_min[ch] = range[0];
+                domain_1d.domain_max[ch] = range[1];
+            }
+        }
+        if (2 == sscanf(buf, "LUT_3D_INPUT_RANGE %f %f", &range[0], &range[1]))
+        {
+            for (int ch = 0; ch < 3; ++ch)
+            {
+                domain_3d.domain_min[ch] = range[0];
+                domain_3d.domain_max[ch] = range[1];
+            }
+        }
+        // Adobe style domain applies to whole file
+        if (3 == sscanf(buf, "DOMAIN_MIN %f %f %f", &range[0], &range[1], &range[2]))
+        {
+            memcpy(domain_1d.domain_min, range, sizeof(range));
+            memcpy(domain_3d.domain_min, range, sizeof(range));
+        }
+        if (3 == sscanf(buf, "DOMAIN_MAX %f %f %f", &range[0], &range[1], &range[2]))
+        {
+            memcpy(domain_1d.domain_max, range, sizeof(range));
+            memcpy(domain_3d.domain_max, range, sizeof(range));
+        }
+        if (strncmp(buf, "TITLE ", 6) == 0)
+        {
+            title = buf + 6;
+            while (!title.empty() && title.back() <= ' ')
+                title.pop_back(); // strip trailing newlines/spaces
+            // strip quotes at start/end
+            if (!title.empty() && title.front() == '"')
+                title = title.substr(1);
+            if (!title.empty() && title.back() == '"')
+                title.pop_back();
+        }
+
+        //@TODO: comment
+    }
+
+    // validate header
+    if (dim_1d < 0 || dim_1d > 65536 || dim_3d < 0 || dim_3d > 4096 || (dim_1d == 0 && dim_3d == 0))
+    {
+        fclose(f);
+        return nullptr;
+    }
+
+    // allocate memory for the data
+    size_t floats_1d = dim_1d > 0 ? dim_1d * 3 : 0;
+    size_t floats_3d = dim_3d > 0 ? dim_3d * dim_3d * dim_3d * 3 : 0;
+
+    smcube_luts* luts = new smcube_luts();
+    luts->title = title;
+    luts->file_data_size = (floats_1d + floats_3d) * sizeof(float);
+    luts->file_data = alloc_file_data(luts->file_data_size);
+
+    smcube_lut lut1d = domain_1d, lut3d = domain_3d;
+    if (dim_1d > 0)
+    {
+        lut1d.channels = 3;
+        lut1d.dimension = 1;
+        lut1d.data_type = smcube_data_type::Float32;
+        lut1d.size_x = dim_1d;
+        lut1d.size_y = 1;
+        lut1d.size_z = 1;
+        lut1d.data = luts->file_data;
+        luts->luts.push_back(lut1d);
+    }
+    if (dim_3d > 0)
+    {
+        lut3d.channels = 3;
+        lut3d.dimension = 3;
+        lut3d.data_type = smcube_data_type::Float32;
+        lut3d.size_x = dim_3d;
+        lut3d.size_y = dim_3d;
+        lut3d.size_z = dim_3d;
+        lut3d.data = luts->file_data + floats_1d * sizeof(float);
+        luts->luts.push_back(lut3d);
+    }
+
+    // read data
+    size_t read_1d = 0, read_3d = 0;
+    while (true) {
+        // note: first data line is already in buf
+        float xyz[3];
+        bool xyzvalid = parse_3floats(buf, buf + strlen(buf), xyz);
+        if (xyzvalid)
+        {
+            if (dim_1d > 0 && read_1d < dim_1d)
+            {
+                ((float*)lut1d.data)[read_1d * 3 + 0] = xyz[0];
+                ((float*)lut1d.data)[read_1d * 3 + 1] = xyz[1];
+                ((float*)lut1d.data)[read_1d * 3 + 2] = xyz[2];
+                ++read_1d;
+            }
+            else if (dim_3d > 0 && read_3d < dim_3d * dim_3d * dim_3d)
+            {
+                ((float*)lut3d.data)[read_3d * 3 + 0] = xyz[0];
+                ((float*)lut3d.data)[read_3d * 3 + 1] = xyz[1];
+                ((float*)lut3d.data)[read_3d * 3 + 2] = xyz[2];
+                ++read_3d;
+            }
+            else
+            {
+                fclose(f);
+                smcube_free(luts);
+                return nullptr;
+            }
+        }
+
+        // read next data line
+        char* res = fgets(buf, sizeof(buf), f);
+        if (!res)
+            break;
+    }
+
+    fclose(f);
+
+    if (dim_1d > 0 && read_1d != dim_1d || dim_3d > 0 && read_3d != dim_3d * dim_3d * dim_3d)
+    {
+        smcube_free(luts);
+        return nullptr;
+    }
+    return luts;
+}
+
+static bool is_lut_supported_by_resolve_cube(const smcube_lut& lut)
+{
+    if (lut.channels != 3 || lut.data_type != smcube_data_type::Float32 || (lut.dimension != 1 && lut.dimension != 3))
+        return false;
+    if (lut.dimension == 3 && (lut.size_x != lut.size_y || lut.size_x != lut.size_z || lut.size_y != lut.size_z))
+        return false;
+    return true;
+}
+
+bool smcube_save_to_file_resolve_cube(const char* path, const smcube_luts* luts)
+{
+    // argument checks
+    if (path == nullptr || luts == nullptr || luts->luts.empty())
+        return false;
+
+    FILE* f = fopen(path, "wb");
+    if (f == nullptr)
+        return false;
+
+    // write header
+    fprintf(f, "# written by smol-cube\n");
+    if (!luts->title.empty())
+        fprintf(f, "TITLE \"%s\"\n", luts->title.c_str());
+    //@TODO: comment
+    for (const smcube_lut& lut : luts->luts)
+    {
+        if (!is_lut_supported_by_resolve_cube(lut))
+            continue;
+        if (lut.dimension == 1)
+            fprintf(f, "LUT_1D_SIZE %i\n", lut.size_x);
+        if (lut.dimension == 3)
+            fprintf(f, "LUT_3D_SIZE %i\n", lut.size_x);
+        if (lut_has_default_domain(lut))
+            continue;
+        bool uniform_domain =
+            lut.domain_min[0] == lut.domain_min[1] && lut.domain_min[0] == lut.domain_min[2] &&
+            lut.domain_max[0] == lut.domain_max[1] && lut.domain_max[0] == lut.domain_max[2];
+        if (uniform_domain)
+        {
+            fprintf(f, "LUT_%iD_INPUT_RANGE %.8f %.8f\n", lut.dimension, lut.domain_min[0], lut.domain_max[0]);
+        }
+        else
+        {
+            // Resolve can not express per-channel ranges; use Adobe style
+            fprintf(f, "DOMAIN_MIN %.8f %.8f %.8f\n", lut.domain_min[0], lut.domain_min[1], lut.domain_min[2]);
+            fprintf(f, "DOMAIN_MAX %.8f %.8f %.8f\n", lut.domain_max[0], lut.domain_max[1], lut.domain_max[2]);
+        }
+    }
+
+    // write data
+    for (const smcube_lut& lut : luts->luts)
+    {
+        if (!is_lut_supported_by_resolve_cube(lut))
+            continue;
+        const float* data = (const float*)lut.data;
+        const float* data_end = data + lut_get_data_size(lut) / sizeof(float);
+        while (data < data_end)
+        {
+            fprintf(f, "%.8f %.8f %.8f\n", data[0], data[1], data[2]);
+            data += 3;
+        }
+    }
+
+    fclose(f);
+    return true;
+}
+
+void smcube_lut_get_domain(const smcube_luts* handle, size_t index, float* dst_min, float* dst_max)
+{
+    smcube_lut lut;
+    if (handle != nullptr && index < handle->luts.size())
+        lut = handle->luts[index];
+    if (dst_min != nullptr)
+        memcpy(dst_min, lut.domain_min, sizeof(lut.domain_min));
+    if (dst_max != nullptr)
+        memcpy(dst_max, lut.domain_max, sizeof(lut.domain_max));
+}
+
+void smcube_lut_convert_data(const smcube_luts* handle, size_t index, smcube_data_type dst_type, int dst_channels, void* dst_data)
+{
+    if (handle == nullptr || index >= handle->luts.size())
+        return;
+    if (dst_data == nullptr || dst_type >= smcube_data_type::DataTypeCount || dst_channels < 1 || dst_channels > 4)
+        return;
+
+    const smcube_lut& lut = handle->luts[index];
+    const size_t data_items = lut.size_x * lut.size_y * lut.size_z;
+    const size_t src_item_size = smcube_data_type_get_size(lut.data_type) * lut.channels;
+
+    if (dst_type == lut.data_type && dst_channels == lut.channels) {
+        // no conversion needed, just copy
+        memcpy(dst_data, lut.data, data_items * src_item_size);
+        return;
+    }
+
+    const int copy_channels = lut.channels < dst_channels ? lut.channels : dst_channels;
+    const int skip_channels = lut.channels - copy_channels;
+    const int zero_channels = dst_channels - copy_channels;
+
+    if (lut.data_type == smcube_data_type::Float16)
+    {
+        // source is FP16
+        const uint16_t* src = (const uint16_t*)lut.data;
+        if (dst_type == smcube_data_type::Float32)
+        {
+            // FP16 -> FP32
+            float* dst = (float*)dst_data;
+            for (size_t i = 0; i < data_items; ++i)
+            {
+                for (int ch = 0; ch < copy_channels; ++ch)
+                    *dst++ = half_to_float(*src++);
+                for (int ch = 0; ch < zero_channels; ++ch)
+                    *dst++ = 0;
+                src += skip_channels;
+            }
+        }
+        else if (dst_type == smcube_data_type::Float16)
+        {
+            // FP16 channels adjust
+            uint16_t* dst = (uint16_t*)dst_data;
+            for (size_t i = 0; i < data_items; ++i)
+            {
+                for (int ch = 0; ch < copy_channels; ++ch)
+                    *dst++ = *src++;
+                for (int ch = 0; ch < zero_channels; ++ch)
+                    *dst++ = 0;
+                src += skip_channels;
+            }
+        }
+    }
+    else if (lut.data_type == smcube_data_type::Float32)
+    {
+        // source is FP32
+        const float* src = (const float*)lut.data;
+        if (dst_type == smcube_data_type::Float16)
+        {
+            // FP32 -> FP16
+            uint16_t* dst = (uint16_t*)dst_data;
+            for (size_t i = 0; i < data_items; ++i)
+            {
+                for (int ch = 0; ch < copy_channels; ++ch)
+                    *dst++ = float_to_half(*src++);
+                for (int ch = 0; ch < zero_channels; ++ch)
+                    *dst++ = 0;
+                src += skip_channels;
+            }
+        }
+        else if (dst_type == smcube_data_type::Float32)
+        {
+            // FP32 channels adjust
+            float* dst = (float*)dst_data;
+            for (size_t i = 0; i < data_items; ++i)
+            {
+                for (int ch = 0; ch < copy_channels; ++ch)
+                    *dst++ = *src++;
+                for (int ch = 0; ch < zero_channels; ++ch)
+                    *dst++ = 0;
+                src += skip_channels;
+            }
+        }
+    }
+}
+
+// --------------------------------------------------------------------------
+// LUT evaluation
+
+static inline float clamp01(float v)
+{
+    return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+}
+
+// Load 4 half-precision floats and convert them to floats in registers.
+static inline Float4 SimdLoadHalf4(const uint16_t* ptr)
+{
+#if defined(HALF_USES_X64_F16C_CONVERSION)
+    return _mm_cvtph_ps(_mm_loadl_epi64((const __m128i*)ptr));
+#elif defined(HALF_USES_X64_SSE2_CONVERSION)
+    __m128i h = _mm_loadl_epi64((const __m128i*)ptr);
+    return F16_to_F32_4x(_mm_unpacklo_epi16(h, h));
+#elif defined(HALF_USES_NEON_CONVERSION)
+    return vcvt_f32_f16(vld1_f16((const float16_t*)ptr));
+#endif
+}
+
+static inline Float4 lut_load4(const float* ptr) { return SimdLoadF(ptr); }
+static inline Float4 lut_load4(const uint16_t* ptr) { return SimdLoadHalf4(ptr); }
+static inline float lut_load1(const float* ptr) { return *ptr; }
+static inline float lut_load1(const uint16_t* ptr) { return half_to_float(*ptr); }
+
+// Memory layout of 3D LUT data.
+enum class lut_layout
+{
+    RowMajor,     // regular row-major layout like in the file, X changing fastest
+    Bricked,      // 4x4x4 cell bricks, see lut_stage_make_bricked
+    CornerPacked, // 8 corners of each cell next to each other, see lut_stage_make_corner_packed
+};
+
+// A single LUT prepared for evaluation: data expanded to 4 channels
+// (RGBA), and input domain turned into coordinate scale & bias. Float16
+// LUT data is kept as halfs, and converted to floats when loaded.
+struct lut_stage
+{
+    int dimension = 3;
+    smcube_data_type data_type = smcube_data_type::Float32;
+    int size_x = 1, size_y = 1, size_z = 1;
+    float coord_scale[4] = {}; // input -> LUT coordinate: v * scale + bias
+    float coord_bias[4] = {};
+    float coord_max[4] = {};   // max LUT coordinate (size-1)
+    float cell_max[4] = {};    // max cell index (size-2)
+    int step_x = 0, step_y = 0, step_z = 0; // data offsets to next item along X/Y/Z, or zero if size is 1
+    lut_layout layout = lut_layout::RowMajor;
+    int blocks_x = 0, blocks_y = 0; // bricks or cells along X/Y, for non-row-major layouts
+    uint8_t input_swizzle[16] = {};  // 2D LUTs: byte shuffle moving input channels into X/Y lanes
+    uint8_t pass_mask[16] = {};      // 2D LUTs: 0xFF bytes for channel passed through from input
+    std::vector<uint8_t> data;
+
+    template<typename T> const T* get_data() const { return (const T*)data.data(); }
+};
+
+// Brick layout of 3D LUT data: LUT cells are grouped into 4x4x4 bricks,
+// each brick storing its 5x5x5 grid points (neighboring bricks share the
+// points on their boundaries). All 8 corners of any cell are then within
+// one ~2KB (for float RGBA) block of memory, instead of being a whole
+// Z slice apart in row-major layout. Memory use is about 2x larger.
+static const int kBrickShift = 2;
+static const int kBrickCells = 1 << kBrickShift;
+static const int kBrickPoints = kBrickCells + 1;
+static const int kBrickItems = kBrickPoints * kBrickPoints * kBrickPoints;
+
+static int brick_count(int size)
+{
+    int cells = size > 1 ? size - 1 : 1;
+    return (cells + kBrickCells - 1) / kBrickCells;
+}
+
+static void lut_stage_make_bricked(lut_stage& st)
+{
+    const size_t item_size = 4 * smcube_data_type_get_size(st.data_type);
+    const int bx = brick_count(st.size_x), by = brick_count(st.size_y), bz = brick_count(st.size_z);
+    std::vector<uint8_t> bricked(size_t(bx) * by * bz * kBrickItems * item_size);
+    uint8_t* dst = bricked.data();
+    for (int ibz = 0; ibz < bz; ++ibz)
+    {
+        for (int iby = 0; iby < by; ++iby)
+        {
+            for (int ibx = 0; ibx < bx; ++ibx)
+            {
+                for (int z = 0; z < kBrickPoints; ++z)
+                {
+                    const int sz = std::min(ibz * kBrickCells + z, st.size_z - 1);
+                    for (int y = 0; y < kBrickPoints; ++y)
+                    {
+                        const int sy = std::min(iby * kBrickCells + y, st.size_y - 1);
+                        for (int x = 0; x < kBrickPoints; ++x)
+                        {
+                            const int sx = std::min(ibx * kBrickCells + x, st.size_x - 1);
+                            memcpy(dst, st.data.data() + ((size_t(sz) * st.size_y + sy) * st.size_x + sx) * item_size, item_size);
+                            dst += item_size;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    st.data.swap(bricked);
+    st.layout = lut_layout::Bricked;
+    st.blocks_x = bx;
+    st.blocks_y = by;
+    st.step_x = st.size_x > 1 ? 4 : 0;
+    st.step_y = st.size_y > 1 ? kBrickPoints * 4 : 0;
+    st.step_z = st.size_z > 1 ? kBrickPoints * kBrickPoints * 4 : 0;
+}
+
+// Corner packed layout of 3D LUT data: each LUT cell stores values of its
+// 8 corners next to each other (in c000, c100, c010, c110, c001, c101,
+// c011, c111 order). Interpolation inputs of a pixel are then one
+// contiguous 8 item load, with no scattered fetches. Costs about 8x
+// more memory.
+static void lut_stage_make_corner_packed(lut_stage& st)
+{
+    const size_t item_size = 4 * smcube_data_type_get_size(st.data_type);
+    const int cx = st.size_x > 1 ? st.size_x - 1 : 1;
+    const int cy = st.size_y > 1 ? st.size_y - 1 : 1;
+    const int cz = st.size_z > 1 ? st.size_z - 1 : 1;
+    std::vector<uint8_t> packed(size_t(cx) * cy * cz * 8 * item_size);
+    uint8_t* dst = packed.data();
+    for (int z = 0; z < cz; ++z)
+    {
+        for (int y = 0; y < cy; ++y)
+        {
+            for (int x = 0; x < cx; ++x)
+            {
+                for (int corner = 0; corner < 8; ++corner)
+                {
+                    const int sx = std::min(x + (corner & 1), st.size_x - 1);
+                    const int sy = std::min(y + ((corner >> 1) & 1), st.size_y - 1);
+                    const int sz = std::min(z + ((corner >> 2) & 1), st.size_z - 1);
+                    memcpy(dst, st.data.data() + ((size_t(sz) * st.size_y + sy) * st.size_x + sx) * item_size, item_size);
+                    dst += item_size;
+                }
+            }
+        }
+    }
+    st.data.swap(packed);
+    st.layout = lut_layout::CornerPacked;
+    st.blocks_x = cx;
+    st.blocks_y = cy;
+    // edge clamping is baked into the data, so corner steps are constant
+    st.step_x = 4;
+    st.step_y = 8;
+    st.step_z = 16;
+}
+
+// 2D LUT is indexed by two input channels; the remaining third channel
+// is either taken from the LUT or passed through from the input.
+static void lut_stage_set_2d_inputs(lut_stage& st, int channel_x, int channel_y, bool pass_through)
+{
+    const int lanes[4] = { channel_x, channel_y, channel_y, 3 };
+    for (int lane = 0; lane < 4; ++lane)
+        for (int b = 0; b < 4; ++b)
+            st.input_swizzle[lane * 4 + b] = uint8_t(lanes[lane] * 4 + b);
+    const int pass_channel = 3 - channel_x - channel_y;
+    for (int ch = 0; ch < 4; ++ch)
+        memset(st.pass_mask + ch * 4, pass_through && ch == pass_channel ? 0xFF : 0, 4);
+}
+
+static void lut_stage_init(lut_stage& st, const smcube_luts* handle, size_t index, smcube_pipeline_flags flags = smcube_pipeline_flag_None)
+{
+    const smcube_lut& lut = handle->luts[index];
+    st.dimension = lut.dimension;
+    st.data_type = lut.data_type == smcube_data_type::Float16 ? smcube_data_type::Float16 : smcube_data_type::Float32;
+    st.size_x = lut.size_x;
+    st.size_y = lut.dimension >= 2 ? lut.size_y : 1;
+    st.size_z = lut.dimension >= 3 ? lut.size_z : 1;
+    // 1D LUTs index all three channels with X
+    const int sizes[3] = { st.size_x, lut.dimension == 1 ? st.size_x : st.size_y, lut.dimension == 1 ? st.size_x : st.size_z };
+    for (int ch = 0; ch < 3; ++ch)
+    {
+        float range = lut.domain_max[ch] - lut.domain_min[ch];
+        st.coord_scale[ch] = range != 0.0f ? float(sizes[ch] - 1) / range : 0.0f;
+        st.coord_bias[ch] = -lut.domain_min[ch] * st.coord_scale[ch];
+        st.coord_max[ch] = float(sizes[ch] - 1);
+        st.cell_max[ch] = sizes[ch] > 1 ? float(sizes[ch] - 2) : 0.0f;
+    }
+    st.step_x = st.size_x > 1 ? 4 : 0;
+    st.step_y = st.size_y > 1 ? st.size_x * 4 : 0;
+    st.step_z = st.size_z > 1 ? st.size_x * st.size_y * 4 : 0;
+    st.data.resize(size_t(st.size_x) * st.size_y * st.size_z * 4 * smcube_data_type_get_size(st.data_type));
+    smcube_lut_convert_data(handle, index, st.data_type, 4, st.data.data());
+    lut_stage_set_2d_inputs(st, 0, 1, false);
+    if ((flags & smcube_pipeline_flag_CornerPackedLayout) && st.dimension == 3)
+        lut_stage_make_corner_packed(st);
+    else if ((flags & smcube_pipeline_flag_BrickLayout) && st.dimension == 3)
+        lut_stage_make_bricked(st);
+}
+
+// Turn input values into integer LUT cell indices and fractions within cells.
+static inline Int4 lut_stage_coords(const lut_stage& st, Float4 c, Float4& frac)
+{
+    Float4 x = SimdAddF(SimdMulF(c, SimdLoadF(st.coord_scale)), SimdLoadF(st.coord_bias));
+    x = SimdClampF(x, SimdZeroF(), SimdLoadF(st.coord_max));
+    Float4 cell = SimdMinF(SimdFloorF(x), SimdLoadF(st.cell_max));
+    frac = SimdSubF(x, cell);
+    return SimdFloatToInt(cell);
+}
+
+// Linear lookup into 1D LUT, separately for each channel.
+template<typename T>
+static inline Float4 lut_stage_eval_1d(const lut_stage& st, Float4 c)
+{
+    Float4 frac;
+    Int4 cell = lut_stage_coords(st, c, frac);
+    const T* d = st.get_data<T>();
+    const int ir = SimdGetLaneI<0>(cell) * 4 + 0;
+    const int ig = SimdGetLaneI<1>(cell) * 4 + 1;
+    const int ib = SimdGetLaneI<2>(cell) * 4 + 2;
+    Float4 v0 = SimdSetF(lut_load1(d + ir), lut_load1(d + ig), lut_load1(d + ib), 0.0f);
+    Float4 v1 = SimdSetF(lut_load1(d + ir + st.step_x), lut_load1(d + ig + st.step_x), lut_load1(d + ib + st.step_x), 0.0f);
+    return SimdLerpF(v0, v1, frac);
+}
+
+// Bilinear lookup into 2D LUT, indexed by two of the input channels.
+template<typename T>
+static inline Float4 lut_stage_eval_2d(const lut_stage& st, Float4 c)
+{
+    Float4 frac;
+    Int4 cell = lut_stage_coords(st, SimdShuffleF(c, SimdLoad(st.input_swizzle)), frac);
+    const T* p = st.get_data<T>() + (size_t(SimdGetLaneI<1>(cell)) * st.size_x + SimdGetLaneI<0>(cell)) * 4;
+    const int sx = st.step_x, sy = st.step_y;
+    Float4 fx = SimdSplatF<0>(frac);
+    Float4 c0 = SimdLerpF(lut_load4(p), lut_load4(p + sx), fx);
+    Float4 c1 = SimdLerpF(lut_load4(p + sy), lut_load4(p + sy + sx), fx);
+    return SimdSelectF(SimdLerpF(c0, c1, SimdSplatF<1>(frac)), c, SimdLoad(st.pass_mask));
+}
+
+// Trilinear lookup into 3D LUT.
+template<typename T>
+static inline Float4 lut_stage_eval_3d(const lut_stage& st, Float4 c)
+{
+    Float4 frac;
+    Int4 cell = lut_stage_coords(st, c, frac);
+    const unsigned cx = SimdGetLaneI<0>(cell), cy = SimdGetLaneI<1>(cell), cz = SimdGetLaneI<2>(cell);
+    size_t item;
+    if (st.layout == lut_layout::CornerPacked)
+    {
+        item = ((size_t(cz) * st.blocks_y + cy) * st.blocks_x + cx) * 8;
+    }
+    else if (st.layout == lut_layout::Bricked)
+    {
+        const size_t brick = (size_t(cz >> kBrickShift) * st.blocks_y + (cy >> kBrickShift)) * st.blocks_x + (cx >> kBrickShift);
+        const unsigned mask = kBrickCells - 1;
+        item = brick * kBrickItems + ((cz & mask) * kBrickPoints + (cy & mask)) * kBrickPoints + (cx & mask);
+    }
+    else
+    {
+        item = (size_t(cz) * st.size_y + cy) * st.size_x + cx;
+    }
+    const T* p = st.get_data<T>() + item * 4;
+    const int sx = st.step_x, sy = st.step_y, sz = st.step_z;
+    Float4 fx = SimdSplatF<0>(frac);
+    Float4 fy = SimdSplatF<1>(frac);
+    Float4 fz = SimdSplatF<2>(frac);
+    Float4 c00 = SimdLerpF(lut_load4(p), lut_load4(p + sx), fx);
+    Float4 c10 = SimdLerpF(lut_load4(p + sy), lut_load4(p + sy + sx), fx);
+    Float4 c01 = SimdLerpF(lut_load4(p + sz), lut_load4(p + sz + sx), fx);
+    Float4 c11 = SimdLerpF(lut_load4(p + sz + sy), lut_load4(p + sz + sy + sx), fx);
+    Float4 c0 = SimdLerpF(c00, c10, fy);
+    Float4 c1 = SimdLerpF(c01, c11, fy);
+    return SimdLerpF(c0, c1, fz);
+}
+
+static inline Float4 lut_stage_eval(const lut_stage& st, Float4 c)
+{
+    if (st.data_type == smcube_data_type::Float16)
+    {
+        if (st.dimension == 1)
+            return lut_stage_eval_1d<uint16_t>(st, c);
+        if (st.dimension == 2)
+            return lut_stage_eval_2d<uint16_t>(st, c);
+        return lut_stage_eval_3d<uint16_t>(st, c);
+    }
+    if (st.dimension == 1)
+        return lut_stage_eval_1d<float>(st, c);
+    if (st.dimension == 2)
+        return lut_stage_eval_2d<float>(st, c);
+    return lut_stage_eval_3d<float>(st, c);
+}
+
+// Fetch a single item of a row-major 3D LUT.
+template<typename T>
+static inline Float4 lut_stage_fetch(const lut_stage& st, int x, int y, int z)
 {
-    if (handle == nullptr)
-        return 0;
-    return handle->luts.size();
+    return lut_load4(st.get_data<T>() + ((size_t(z) * st.size_y + y) * st.size_x + x) * 4);
 }
 
-smcube_lut smcube_get_lut(const smcube_luts* handle, size_t index)
+// Tetrahedral lookup into row-major 3D LUT: interpolates between 4 of the
+// cell corners, picked based on which of the 6 tetrahedra within the cell
+// the input point is in.
+template<typename T>
+static inline Float4 lut_stage_eval_3d_tetrahedral(const lut_stage& st, Float4 c)
 {
-    if (handle == nullptr || index >= handle->luts.size())
-        return smcube_lut();
-    return handle->luts[index];
+    Float4 frac;
+    Int4 cell = lut_stage_coords(st, c, frac);
+    const T* p = st.get_data<T>() +
+        ((size_t(SimdGetLaneI<2>(cell)) * st.size_y + SimdGetLaneI<1>(cell)) * st.size_x + SimdGetLaneI<0>(cell)) * 4;
+    const int sx = st.step_x, sy = st.step_y, sz = st.step_z;
+    float f[4];
+    SimdStoreF(f, frac);
+    const float fx = f[0], fy = f[1], fz = f[2];
+    Float4 c000 = lut_load4(p);
+    Float4 c111 = lut_load4(p + sx + sy + sz);
+    // pick the tetrahedron: two other corners, and weights along the path c000 -> ca -> cb -> c111
+    Float4 ca, cb;
+    float w0, w1, w2;
+    if (fx > fy)
+    {
+        if (fy > fz)      { ca = lut_load4(p + sx); cb = lut_load4(p + sx + sy); w0 = fx; w1 = fy; w2 = fz; }
+        else if (fx > fz) { ca = lut_load4(p + sx); cb = lut_load4(p + sx + sz); w0 = fx; w1 = fz; w2 = fy; }
+        else              { ca = lut_load4(p + sz); cb = lut_load4(p + sx + sz); w0 = fz; w1 = fx; w2 = fy; }
+    }
+    else
+    {
+        if (fz > fy)      { ca = lut_load4(p + sz); cb = lut_load4(p + sy + sz); w0 = fz; w1 = fy; w2 = fx; }
+        else if (fz > fx) { ca = lut_load4(p + sy); cb = lut_load4(p + sy + sz); w0 = fy; w1 = fz; w2 = fx; }
+        else              { ca = lut_load4(p + sy); cb = lut_load4(p + sx + sy); w0 = fy; w1 = fx; w2 = fz; }
+    }
+    Float4 res = SimdAddF(c000, SimdMulF(SimdSubF(ca, c000), SimdSet1F(w0)));
+    res = SimdAddF(res, SimdMulF(SimdSubF(cb, ca), SimdSet1F(w1)));
+    res = SimdAddF(res, SimdMulF(SimdSubF(c111, cb), SimdSet1F(w2)));
+    return res;
 }
 
-int smcube_lut_get_channels(const smcube_luts* handle, size_t index)
+// Catmull-Rom cubic weights for fraction t.
+static inline void cubic_weights(float t, float* w)
 {
-    if (handle == nullptr || index >= handle->luts.size())
-        return 0;
-    return handle->luts[index].channels;
+    const float t2 = t * t, t3 = t2 * t;
+    w[0] = 0.5f * (-t3 + 2.0f * t2 - t);
+    w[1] = 0.5f * (3.0f * t3 - 5.0f * t2 + 2.0f);
+    w[2] = 0.5f * (-3.0f * t3 + 4.0f * t2 + t);
+    w[3] = 0.5f * (t3 - t2);
 }
-int smcube_lut_get_dimension(const smcube_luts* handle, size_t index)
+
+// Tricubic (Catmull-Rom) lookup into row-major 3D LUT, using 4x4x4 items
+// around the input point; items outside of LUT are clamped to the edges.
+template<typename T>
+static inline Float4 lut_stage_eval_3d_tricubic(const lut_stage& st, Float4 c)
 {
-    if (handle == nullptr || index >= handle->luts.size())
-        return 0;
-    return handle->luts[index].dimension;
+    Float4 frac;
+    Int4 cell = lut_stage_coords(st, c, frac);
+    float f[4];
+    SimdStoreF(f, frac);
+    const int cx = SimdGetLaneI<0>(cell), cy = SimdGetLaneI<1>(cell), cz = SimdGetLaneI<2>(cell);
+    float wx[4], wy[4], wz[4];
+    cubic_weights(f[0], wx);
+    cubic_weights(f[1], wy);
+    cubic_weights(f[2], wz);
+    int ix[4], iy[4], iz[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        ix[i] = std::min(std::max(cx + i - 1, 0), st.size_x - 1);
+        iy[i] = std::min(std::max(cy + i - 1, 0), st.size_y - 1);
+        iz[i] = std::min(std::max(cz + i - 1, 0), st.size_z - 1);
+    }
+    Float4 res = SimdZeroF();
+    for (int z = 0; z < 4; ++z)
+    {
+        Float4 rz = SimdZeroF();
+        for (int y = 0; y < 4; ++y)
+        {
+            Float4 ry = SimdZeroF();
+            for (int x = 0; x < 4; ++x)
+                ry = SimdAddF(ry, SimdMulF(lut_stage_fetch<T>(st, ix[x], iy[y], iz[z]), SimdSet1F(wx[x])));
+            rz = SimdAddF(rz, SimdMulF(ry, SimdSet1F(wy[y])));
+        }
+        res = SimdAddF(res, SimdMulF(rz, SimdSet1F(wz[z])));
+    }
+    return res;
 }
-smcube_data_type smcube_lut_get_data_type(const smcube_luts* handle, size_t index)
+
+// Lookup into row-major 3D LUT with given interpolation.
+template<typename T>
+static Float4 lut_stage_eval_3d_interp(const lut_stage& st, Float4 c, smcube_interpolation interp)
 {
-    if (handle == nullptr || index >= handle->luts.size())
-        return smcube_data_type::Float32;
-    return handle->luts[index].data_type;
+    switch (interp)
+    {
+    case smcube_interpolation::Tetrahedral: return lut_stage_eval_3d_tetrahedral<T>(st, c);
+    case smcube_interpolation::Tricubic: return lut_stage_eval_3d_tricubic<T>(st, c);
+    default: return lut_stage_eval_3d<T>(st, c);
+    }
 }
-int smcube_lut_get_size_x(const smcube_luts* handle, size_t index)
+
+// --------------------------------------------------------------------------
+// Baked 8 bit/channel LUT
+
+struct smcube_baked_lut8
 {
-    if (handle == nullptr || index >= handle->luts.size())
-        return 0;
-    return handle->luts[index].size_x;
+    uint32_t* table = nullptr; // RGBA8 entries indexed by R | G<<8 | B<<16
+    double build_time = 0.0;
+};
+
+static const size_t kBakedLut8Entries = 256 * 256 * 256;
+
+static inline uint32_t float_to_unorm8(float v)
+{
+    return uint32_t(clamp01(v) * 255.0f + 0.5f);
 }
-int smcube_lut_get_size_y(const smcube_luts* handle, size_t index)
+
+smcube_baked_lut8* smcube_baked_lut8_create(const smcube_luts* handle, size_t index)
 {
     if (handle == nullptr || index >= handle->luts.size())
-        return 0;
-    return handle->luts[index].size_y;
+        return nullptr;
+    if (handle->luts[index].dimension != 3)
+        return nullptr;
+
+    auto t0 = std::chrono::steady_clock::now();
+
+    lut_stage st;
+    lut_stage_init(st, handle, index);
+
+    smcube_baked_lut8* baked = new smcube_baked_lut8();
+    baked->table = new uint32_t[kBakedLut8Entries];
+
+    // each blue slice of the table computed independently
+    parallel_for(256, 1, [&](size_t begin, size_t end)
+    {
+        float res[4];
+        for (size_t b = begin; b < end; ++b)
+        {
+            uint32_t* dst = baked->table + b * 256 * 256;
+            for (int g = 0; g < 256; ++g)
+            {
+                for (int r = 0; r < 256; ++r)
+                {
+                    SimdStoreF(res, lut_stage_eval(st, SimdSetF(r / 255.0f, g / 255.0f, b / 255.0f, 0.0f)));
+                    *dst++ = float_to_unorm8(res[0]) | (float_to_unorm8(res[1]) << 8) | (float_to_unorm8(res[2]) << 16) | 0xFF000000;
+                }
+            }
+        }
+    });
+
+    baked->build_time = get_time_ms_since(t0);
+    return baked;
 }
-int smcube_lut_get_size_z(const smcube_luts* handle, size_t index)
+
+void smcube_baked_lut8_free(smcube_baked_lut8* baked)
 {
-    if (handle == nullptr || index >= handle->luts.size())
-        return 0;
-    return handle->luts[index].size_z;
+    if (baked)
+        delete[] baked->table;
+    delete baked;
 }
-const void* smcube_lut_get_data(const smcube_luts* handle, size_t index)
+
+size_t smcube_baked_lut8_get_memory_size(const smcube_baked_lut8* baked)
 {
-    if (handle == nullptr || index >= handle->luts.size())
+    if (baked == nullptr)
         return 0;
-    return handle->luts[index].data;
+    return sizeof(*baked) + kBakedLut8Entries * sizeof(baked->table[0]);
 }
 
-static size_t lut_get_data_size(const smcube_lut& lut)
+double smcube_baked_lut8_get_build_time(const smcube_baked_lut8* baked)
 {
-    size_t item_size = smcube_data_type_get_size(lut.data_type) * lut.channels;
-    size_t item_count = 1;
-    if (lut.dimension >= 1) item_count *= lut.size_x;
-    if (lut.dimension >= 2) item_count *= lut.size_y;
-    if (lut.dimension >= 3) item_count *= lut.size_z;
-    return item_count * item_size;
+    if (baked == nullptr)
+        return 0.0;
+    return baked->build_time;
 }
 
-size_t smcube_lut_get_data_size(const smcube_luts* handle, size_t index)
+void smcube_baked_lut8_apply(const smcube_baked_lut8* baked, const uint8_t* src, uint8_t* dst, size_t pixel_count, int channels)
+{
+    if (baked == nullptr || src == nullptr || dst == nullptr || (channels != 3 && channels != 4))
+        return;
+
+    const uint32_t* table = baked->table;
+    parallel_for(pixel_count, 64 * 1024, [&](size_t begin, size_t end)
+    {
+        const uint8_t* s = src + begin * channels;
+        uint8_t* d = dst + begin * channels;
+        if (channels == 4)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                uint32_t v;
+                memcpy(&v, s, 4);
+                uint32_t res = (table[v & 0xFFFFFF] & 0xFFFFFF) | (v & 0xFF000000);
+                memcpy(d, &res, 4);
+                s += 4;
+                d += 4;
+            }
+        }
+        else
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                uint32_t res = table[s[0] | (s[1] << 8) | (s[2] << 16)];
+                d[0] = uint8_t(res);
+                d[1] = uint8_t(res >> 8);
+                d[2] = uint8_t(res >> 16);
+                s += 3;
+                d += 3;
+            }
+        }
+    });
+}
+
+// --------------------------------------------------------------------------
+// Baked 1D LUT for half-float inputs
+
+struct smcube_baked_lut1d_half
+{
+    // four tables of 65536 Float16 entries (R, G, B, and identity for alpha),
+    // indexed by the half-float input; plus padding so that 32 bit gathers
+    // from the last entry stay within memory
+    uint16_t* table = nullptr;
+    double build_time = 0.0;
+};
+
+static const size_t kBakedHalfEntries = 65536;
+static const size_t kBakedHalfTableSize = kBakedHalfEntries * 4 + 2;
+
+smcube_baked_lut1d_half* smcube_baked_lut1d_half_create(const smcube_luts* handle, size_t index)
 {
     if (handle == nullptr || index >= handle->luts.size())
+        return nullptr;
+    if (handle->luts[index].dimension != 1)
+        return nullptr;
+
+    auto t0 = std::chrono::steady_clock::now();
+
+    lut_stage st;
+    lut_stage_init(st, handle, index);
+
+    smcube_baked_lut1d_half* baked = new smcube_baked_lut1d_half();
+    baked->table = new uint16_t[kBakedHalfTableSize];
+    baked->table[kBakedHalfTableSize - 2] = baked->table[kBakedHalfTableSize - 1] = 0;
+
+    // chunks of the input range computed independently; inputs and results
+    // are converted with the bulk SIMD half conversion functions
+    const size_t kChunk = 1024;
+    parallel_for(kBakedHalfEntries / kChunk, 1, [&](size_t begin, size_t end)
+    {
+        uint16_t input[kChunk];
+        float input_f[kChunk];
+        float res[3][kChunk];
+        float tmp[4];
+        for (size_t chunk = begin; chunk < end; ++chunk)
+        {
+            for (size_t i = 0; i < kChunk; ++i)
+                input[i] = uint16_t(chunk * kChunk + i);
+            half_to_float(input, input_f, kChunk);
+            for (size_t i = 0; i < kChunk; ++i)
+            {
+                SimdStoreF(tmp, lut_stage_eval(st, SimdSet1F(input_f[i])));
+                res[0][i] = tmp[0];
+                res[1][i] = tmp[1];
+                res[2][i] = tmp[2];
+            }
+            for (int ch = 0; ch < 3; ++ch)
+                float_to_half(res[ch], baked->table + ch * kBakedHalfEntries + chunk * kChunk, kChunk);
+            memcpy(baked->table + 3 * kBakedHalfEntries + chunk * kChunk, input, sizeof(input));
+        }
+    });
+
+    baked->build_time = get_time_ms_since(t0);
+    return baked;
+}
+
+void smcube_baked_lut1d_half_free(smcube_baked_lut1d_half* baked)
+{
+    if (baked)
+        delete[] baked->table;
+    delete baked;
+}
+
+size_t smcube_baked_lut1d_half_get_memory_size(const smcube_baked_lut1d_half* baked)
+{
+    if (baked == nullptr)
         return 0;
-    return lut_get_data_size(handle->luts[index]);
+    return sizeof(*baked) + kBakedHalfTableSize * sizeof(baked->table[0]);
 }
 
-static bool str_ends_with(const char* str, const char* suffix)
+double smcube_baked_lut1d_half_get_build_time(const smcube_baked_lut1d_half* baked)
 {
-    size_t str_len = strlen(str);
-    size_t suffix_len = strlen(suffix);
-    if (suffix_len > str_len)
+    if (baked == nullptr)
+        return 0.0;
+    return baked->build_time;
+}
+
+#if CPU_HAS_AVX2_PATH
+// 8 values at a time: widen to 32 bit, add offset of the table for each
+// value's channel, gather 32 bits from each and narrow back. Channel pattern
+// repeats every 8 values for RGBA, every 24 for RGB. Returns how many values
+// were done (a multiple of 24).
+CPU_AVX2_TARGET static size_t baked_lut1d_half_apply_avx2(const uint16_t* table, const uint16_t* s, uint16_t* d, size_t count, int channels)
+{
+    const int kTable = int(kBakedHalfEntries);
+    const __m256i rgba = _mm256_setr_epi32(0, kTable, kTable * 2, kTable * 3, 0, kTable, kTable * 2, kTable * 3);
+    const __m256i offsets[3] = {
+        channels == 4 ? rgba : _mm256_setr_epi32(0, kTable, kTable * 2, 0, kTable, kTable * 2, 0, kTable),
+        channels == 4 ? rgba : _mm256_setr_epi32(kTable * 2, 0, kTable, kTable * 2, 0, kTable, kTable * 2, 0),
+        channels == 4 ? rgba : _mm256_setr_epi32(kTable, kTable * 2, 0, kTable, kTable * 2, 0, kTable, kTable * 2),
+    };
+    const __m256i mask16 = _mm256_set1_epi32(0xFFFF);
+    size_t i = 0;
+    for (; i + 24 <= count; i += 24)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            __m256i idx = _mm256_add_epi32(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(s + k * 8))), offsets[k]);
+            __m256i v = _mm256_and_si256(_mm256_i32gather_epi32((const int*)table, idx, 2), mask16);
+            __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+            _mm_storeu_si128((__m128i*)(d + k * 8), packed);
+        }
+        s += 24;
+        d += 24;
+    }
+    return i;
+}
+#endif
+
+void smcube_baked_lut1d_half_apply(const smcube_baked_lut1d_half* baked, const uint16_t* src, uint16_t* dst, size_t pixel_count, int channels)
+{
+    if (baked == nullptr || src == nullptr || dst == nullptr || (channels != 3 && channels != 4))
+        return;
+
+    const uint16_t* table = baked->table;
+#if CPU_HAS_AVX2_PATH
+    const bool has_avx2 = cpu_supports_avx2();
+#endif
+    parallel_for(pixel_count, 64 * 1024, [&](size_t begin, size_t end)
+    {
+        const uint16_t* s = src + begin * channels;
+        uint16_t* d = dst + begin * channels;
+        size_t count = (end - begin) * channels;
+        size_t i = 0;
+#if CPU_HAS_AVX2_PATH
+        if (has_avx2)
+            i = baked_lut1d_half_apply_avx2(table, s, d, count, channels);
+        s += i;
+        d += i;
+#endif
+        // scalar tail (or all of it without gather instructions)
+        int ch = int(i % channels);
+        for (; i < count; ++i)
+        {
+            *d++ = table[ch * kBakedHalfEntries + *s++];
+            if (++ch == channels)
+                ch = 0;
+        }
+    });
+}
+
+// --------------------------------------------------------------------------
+// LUT application pipeline
+
+struct smcube_pipeline
+{
+    std::vector<lut_stage> stages;
+    float domain_min[3] = { 0.0f, 0.0f, 0.0f }; // input domain of the first LUT
+    float domain_max[3] = { 1.0f, 1.0f, 1.0f };
+    bool color_cache = false;
+};
+
+static inline Float4 pipeline_eval(const smcube_pipeline& pipe, Float4 c)
+{
+    for (const lut_stage& st : pipe.stages)
+        c = lut_stage_eval(st, c);
+    return c;
+}
+
+// Direct-mapped cache of pipeline results, keyed on exact bits of input RGB.
+// 1024 entries of 32 bytes each, so it stays within L1/L2 cache.
+static const uint32_t kColorCacheSize = 1024;
+
+struct color_cache_entry
+{
+    uint32_t key[3];
+    uint32_t valid;
+    float value[4];
+};
+
+static inline uint32_t color_cache_index(const uint32_t* key)
+{
+    uint32_t h = key[0] * 0x9E3779B1u ^ key[1] * 0x85EBCA77u ^ key[2] * 0xC2B2AE3Du;
+    return h >> 22;
+}
+
+static inline bool color_cache_key_equal(const uint32_t* a, const uint32_t* b)
+{
+    return a[0] == b[0] && a[1] == b[1] && a[2] == b[2];
+}
+
+static void pipeline_apply_cached(const smcube_pipeline& pipe, const float* s, float* d, size_t count, int channels)
+{
+    std::vector<color_cache_entry> cache(kColorCacheSize);
+    uint32_t prev_key[3];
+    float prev_res[4];
+    bool have_prev = false;
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint32_t key[3];
+        memcpy(key, s, sizeof(key));
+        const float alpha = channels == 4 ? s[3] : 0.0f;
+        // runs of the same color within a scanline are the most common
+        // case, check for those first
+        if (!have_prev || !color_cache_key_equal(key, prev_key))
+        {
+            color_cache_entry& e = cache[color_cache_index(key)];
+            if (!e.valid || !color_cache_key_equal(key, e.key))
+            {
+                SimdStoreF(e.value, pipeline_eval(pipe, SimdSetF(s[0], s[1], s[2], 0.0f)));
+                memcpy(e.key, key, sizeof(key));
+                e.valid = 1;
+            }
+            memcpy(prev_key, key, sizeof(key));
+            memcpy(prev_res, e.value, sizeof(prev_res));
+            have_prev = true;
+        }
+        d[0] = prev_res[0];
+        d[1] = prev_res[1];
+        d[2] = prev_res[2];
+        if (channels == 4)
+            d[3] = alpha;
+        s += channels;
+        d += channels;
+    }
+}
+
+smcube_pipeline* smcube_pipeline_create(const smcube_luts* handle, smcube_pipeline_flags flags)
+{
+    if (handle == nullptr)
+        return nullptr;
+    smcube_pipeline* pipe = new smcube_pipeline();
+    for (size_t index = 0; index < handle->luts.size(); ++index)
+    {
+        const int dim = handle->luts[index].dimension;
+        if (dim < 1 || dim > 3)
+            continue;
+        // domain of 2D LUT is along its two axes, not along RGB
+        if (pipe->stages.empty() && dim != 2)
+        {
+            memcpy(pipe->domain_min, handle->luts[index].domain_min, sizeof(pipe->domain_min));
+            memcpy(pipe->domain_max, handle->luts[index].domain_max, sizeof(pipe->domain_max));
+        }
+        pipe->stages.emplace_back();
+        lut_stage_init(pipe->stages.back(), handle, index, flags);
+    }
+    pipe->color_cache = (flags & smcube_pipeline_flag_ColorCache) != 0;
+    return pipe;
+}
+
+void smcube_pipeline_free(smcube_pipeline* pipe)
+{
+    delete pipe;
+}
+
+bool smcube_pipeline_set_2d_inputs(smcube_pipeline* pipe, size_t index, int channel_x, int channel_y, bool pass_through)
+{
+    if (pipe == nullptr || index >= pipe->stages.size() || pipe->stages[index].dimension != 2)
         return false;
-    return memcmp(str + str_len - suffix_len, suffix, suffix_len) == 0;
+    if (channel_x < 0 || channel_x > 2 || channel_y < 0 || channel_y > 2 || channel_x == channel_y)
+        return false;
+    lut_stage_set_2d_inputs(pipe->stages[index], channel_x, channel_y, pass_through);
+    return true;
 }
 
-smcube_luts* smcube_load_from_file(const char* path)
+void smcube_pipeline_apply(const smcube_pipeline* pipe, const float* src, float* dst, size_t pixel_count, int channels)
 {
-    if (str_ends_with(path, ".cube"))
-        return smcube_load_from_file_resolve_cube(path);
-    if (str_ends_with(path, ".smcube"))
-        return smcube_load_from_file_smcube(path);
-    return nullptr;
+    if (pipe == nullptr || src == nullptr || dst == nullptr || (channels != 3 && channels != 4))
+        return;
+
+    parallel_for(pixel_count, 16 * 1024, [&](size_t begin, size_t end)
+    {
+        const float* s = src + begin * channels;
+        float* d = dst + begin * channels;
+        if (pipe->color_cache)
+        {
+            pipeline_apply_cached(*pipe, s, d, end - begin, channels);
+            return;
+        }
+        float res[4];
+        for (size_t i = begin; i < end; ++i)
+        {
+            // all LUTs are evaluated for one pixel at a time
+            Float4 c = channels == 4 ? SimdLoadF(s) : SimdSetF(s[0], s[1], s[2], 0.0f);
+            const float alpha = channels == 4 ? s[3] : 0.0f;
+            c = pipeline_eval(*pipe, c);
+            SimdStoreF(res, c);
+            d[0] = res[0];
+            d[1] = res[1];
+            d[2] = res[2];
+            if (channels == 4)
+                d[3] = alpha;
+            s += channels;
+            d += channels;
+        }
+    });
 }
 
-smcube_luts* smcube_load_from_file_smcube(const char* path)
+// Either crossfade between results of two pipelines, or (if second one is
+// null) blend between input and the result of first one.
+static inline Float4 pipeline_eval_blend(const smcube_pipeline& pipe_a, const smcube_pipeline* pipe_b, Float4 factor, Float4 c)
 {
-    if (path == nullptr)
+    Float4 ca = pipeline_eval(pipe_a, c);
+    if (pipe_b == nullptr)
+        return SimdLerpF(c, ca, factor);
+    return SimdLerpF(ca, pipeline_eval(*pipe_b, c), factor);
+}
+
+void smcube_pipeline_apply_blend(const smcube_pipeline* pipe_a, const smcube_pipeline* pipe_b, float factor, const float* src, float* dst, size_t pixel_count, int channels)
+{
+    if (pipe_a == nullptr || src == nullptr || dst == nullptr || (channels != 3 && channels != 4))
+        return;
+
+    const Float4 t = SimdSet1F(factor);
+    parallel_for(pixel_count, 16 * 1024, [&](size_t begin, size_t end)
+    {
+        const float* s = src + begin * channels;
+        float* d = dst + begin * channels;
+        float res[4];
+        for (size_t i = begin; i < end; ++i)
+        {
+            Float4 c = channels == 4 ? SimdLoadF(s) : SimdSetF(s[0], s[1], s[2], 0.0f);
+            const float alpha = channels == 4 ? s[3] : 0.0f;
+            c = pipeline_eval_blend(*pipe_a, pipe_b, t, c);
+            SimdStoreF(res, c);
+            d[0] = res[0];
+            d[1] = res[1];
+            d[2] = res[2];
+            if (channels == 4)
+                d[3] = alpha;
+            s += channels;
+            d += channels;
+        }
+    });
+}
+
+// --------------------------------------------------------------------------
+// Baking LUT chain into a single 3D LUT
+
+// Bake result of eval function over given input domain into a new 3D LUT,
+// optionally measuring max error of the result.
+template<typename Eval>
+static smcube_luts* bake_to_3d_impl(const smcube_luts* handle, const float* domain_min, const float* domain_max, int size, float* dst_max_error, Eval eval)
+{
+    // result LUT covers the input domain of the whole chain
+    const size_t data_items = size_t(size) * size * size;
+    smcube_luts* res = new smcube_luts();
+    res->title = handle->title;
+    res->comment = handle->comment;
+    res->file_data_size = data_items * 3 * sizeof(float);
+    res->file_data = alloc_file_data(res->file_data_size);
+    smcube_lut lut;
+    lut.channels = 3;
+    lut.dimension = 3;
+    lut.data_type = smcube_data_type::Float32;
+    lut.size_x = lut.size_y = lut.size_z = size;
+    memcpy(lut.domain_min, domain_min, sizeof(lut.domain_min));
+    memcpy(lut.domain_max, domain_max, sizeof(lut.domain_max));
+    lut.data = res->file_data;
+    res->luts.push_back(lut);
+
+    Float4 dmin = SimdSetF(lut.domain_min[0], lut.domain_min[1], lut.domain_min[2], 0.0f);
+    Float4 drange = SimdSubF(SimdSetF(lut.domain_max[0], lut.domain_max[1], lut.domain_max[2], 0.0f), dmin);
+    const float inv_size = 1.0f / float(size - 1);
+
+    // resample the chain at grid points, each Z slice independently
+    parallel_for(size, 1, [&](size_t begin, size_t end)
+    {
+        float tmp[4];
+        for (size_t z = begin; z < end; ++z)
+        {
+            float* dst = (float*)lut.data + z * size * size * 3;
+            for (int y = 0; y < size; ++y)
+            {
+                for (int x = 0; x < size; ++x)
+                {
+                    Float4 t = SimdMulF(SimdSetF(float(x), float(y), float(z), 0.0f), SimdSet1F(inv_size));
+                    SimdStoreF(tmp, eval(SimdAddF(dmin, SimdMulF(t, drange))));
+                    dst[0] = tmp[0];
+                    dst[1] = tmp[1];
+                    dst[2] = tmp[2];
+                    dst += 3;
+                }
+            }
+        }
+    });
+
+    // measure error against exact chain evaluation at centers of the
+    // grid cells, which is where interpolation error is the largest
+    if (dst_max_error != nullptr)
+    {
+        lut_stage baked;
+        lut_stage_init(baked, res, 0);
+        std::vector<float> slice_error(size - 1, 0.0f);
+        parallel_for(size - 1, 1, [&](size_t begin, size_t end)
+        {
+            float tmp[4];
+            for (size_t z = begin; z < end; ++z)
+            {
+                Float4 max_err = SimdZeroF();
+                for (int y = 0; y < size - 1; ++y)
+                {
+                    for (int x = 0; x < size - 1; ++x)
+                    {
+                        Float4 t = SimdMulF(SimdSetF(x + 0.5f, y + 0.5f, z + 0.5f, 0.0f), SimdSet1F(inv_size));
+                        Float4 c = SimdAddF(dmin, SimdMulF(t, drange));
+                        Float4 diff = SimdSubF(eval(c), lut_stage_eval(baked, c));
+                        max_err = SimdMaxF(max_err, SimdMaxF(diff, SimdSubF(SimdZeroF(), diff)));
+                    }
+                }
+                SimdStoreF(tmp, max_err);
+                slice_error[z] = std::max(tmp[0], std::max(tmp[1], tmp[2]));
+            }
+        });
+        for (float err : slice_error)
+            *dst_max_error = std::max(*dst_max_error, err);
+    }
+
+    return res;
+}
+
+// bakes the chain over given domain, or over the chain domain if that is null
+static smcube_luts* bake_chain_to_3d(const smcube_luts* handle, int size, const float* domain_min, const float* domain_max, float* dst_max_error)
+{
+    if (dst_max_error != nullptr)
+        *dst_max_error = 0.0f;
+    if (handle == nullptr || size < 2 || size > 4096)
         return nullptr;
 
-    FILE* f = fopen(path, "rb");
-    if (f == nullptr)
+    smcube_pipeline* pipe = smcube_pipeline_create(handle);
+    if (pipe->stages.empty())
+    {
+        smcube_pipeline_free(pipe);
         return nullptr;
+    }
+    if (domain_min == nullptr || domain_max == nullptr)
+    {
+        domain_min = pipe->domain_min;
+        domain_max = pipe->domain_max;
+    }
+    smcube_luts* res = bake_to_3d_impl(handle, domain_min, domain_max, size, dst_max_error,
+        [&](Float4 c) { return pipeline_eval(*pipe, c); });
+    smcube_pipeline_free(pipe);
+    return res;
+}
 
-    fseek(f, 0, SEEK_END);
-    int file_size = ftell(f);
-    fseek(f, 0, SEEK_SET);
-    if (file_size < 4)
+smcube_luts* smcube_bake_to_3d(const smcube_luts* handle, int size, float* dst_max_error)
+{
+    return bake_chain_to_3d(handle, size, nullptr, nullptr, dst_max_error);
+}
+
+smcube_luts* smcube_bake_to_3d_domain(const smcube_luts* handle, int size, const float* domain_min, const float* domain_max, float* dst_max_error)
+{
+    if (domain_min == nullptr || domain_max == nullptr)
     {
-        fclose(f);
+        if (dst_max_error != nullptr)
+            *dst_max_error = 0.0f;
         return nullptr;
     }
+    return bake_chain_to_3d(handle, size, domain_min, domain_max, dst_max_error);
+}
 
-    smcube_luts* luts = new smcube_luts();
-    luts->file_data_size = file_size;
-    luts->file_data = new uint8_t[file_size];
-    fread(luts->file_data, 1, file_size, f);
-    fclose(f);
+smcube_luts* smcube_bake_blend_to_3d(const smcube_luts* handle_a, const smcube_luts* handle_b, float factor, int size)
+{
+    if (handle_a == nullptr || size < 2 || size > 4096)
+        return nullptr;
 
-    if (memcmp(luts->file_data, "SML1", 4) != 0)
+    smcube_pipeline* pipe_a = smcube_pipeline_create(handle_a);
+    smcube_pipeline* pipe_b = handle_b != nullptr ? smcube_pipeline_create(handle_b) : nullptr;
+    if (pipe_a->stages.empty() || (pipe_b != nullptr && pipe_b->stages.empty()))
     {
-        smcube_free(luts);
+        smcube_pipeline_free(pipe_a);
+        smcube_pipeline_free(pipe_b);
         return nullptr;
     }
-    // parse chunks
-    size_t offset = 4;
-    while (offset + 12 < luts->file_data_size)
+    // cover input domains of both
+    float domain_min[3], domain_max[3];
+    for (int ch = 0; ch < 3; ++ch)
     {
-        // get and validate chunk length
-        uint64_t chunk_len;
-        memcpy(&chunk_len, luts->file_data + offset + 4, 8);
-        if (offset + 12 + chunk_len > luts->file_data_size)
-        {
-            smcube_free(luts);
-            return nullptr;
-        }
-        if (memcmp(luts->file_data + offset, "Titl", 4) == 0 && chunk_len > 0)
+        domain_min[ch] = pipe_a->domain_min[ch];
+        domain_max[ch] = pipe_a->domain_max[ch];
+        if (pipe_b != nullptr)
         {
-            const char* str_ptr = (const char*)luts->file_data + offset + 12;
-            luts->title = std::string(str_ptr, str_ptr + chunk_len);
-        }
-        if (memcmp(luts->file_data + offset, "Comm", 4) == 0 && chunk_len > 0)
-        {
-            const char* str_ptr = (const char*)luts->file_data + offset + 12;
-            luts->comment = std::string(str_ptr, str_ptr + chunk_len);
+            domain_min[ch] = std::min(domain_min[ch], pipe_b->domain_min[ch]);
+            domain_max[ch] = std::max(domain_max[ch], pipe_b->domain_max[ch]);
         }
-        if (memcmp(luts->file_data + offset, "ALut", 4) == 0 && chunk_len > sizeof(smcube_file_alut_header))
-        {
-            smcube_file_alut_header head;
-            memcpy(&head, luts->file_data + offset + 12, sizeof(head));
+    }
+    const Float4 t = SimdSet1F(factor);
+    smcube_luts* res = bake_to_3d_impl(handle_a, domain_min, domain_max, size, nullptr,
+        [&](Float4 c) { return pipeline_eval_blend(*pipe_a, pipe_b, t, c); });
+    smcube_pipeline_free(pipe_a);
+    smcube_pipeline_free(pipe_b);
+    return res;
+}
 
-            // validate lut header
-            if (head.channels < 1 || head.channels > 4 ||
-                head.dimension < 1 || head.dimension > 3 ||
-                head.data_type >= uint32_t(smcube_data_type::DataTypeCount) ||
-                head.filter >= uint32_t(smcube_data_filter::FilterCount) ||
-                head.size_x > 65536 || head.size_y > 65536 || head.size_z > 65536)
-            {
-                smcube_free(luts);
-                return nullptr;
-            }
+// --------------------------------------------------------------------------
+// Planar / strided image application
 
-            smcube_lut lut;
-            lut.channels = head.channels;
-            lut.dimension = head.dimension;
-            lut.data_type = smcube_data_type(head.data_type);
-            lut.size_x = head.size_x;
-            lut.size_y = head.size_y;
-            lut.size_z = head.size_z;
-            size_t lut_data_size = lut_get_data_size(lut);
-            if (chunk_len - sizeof(smcube_file_alut_header) != lut_data_size)
-            {
-                smcube_free(luts);
-                return nullptr;
-            }
+smcube_image smcube_image_interleaved(float* data, int width, int height, int channels)
+{
+    smcube_image img;
+    if (data == nullptr || channels < 3 || channels > 4)
+        return img;
+    for (int ch = 0; ch < channels; ++ch)
+        img.channels[ch] = data + ch;
+    img.pixel_stride = channels * sizeof(float);
+    img.row_stride = img.pixel_stride * width;
+    img.width = width;
+    img.height = height;
+    return img;
+}
 
-            // point to file data
-            lut.data = luts->file_data + offset + 12 + sizeof(smcube_file_alut_header);
+smcube_image smcube_image_planar(float* r, float* g, float* b, float* a, int width, int height, ptrdiff_t row_stride)
+{
+    smcube_image img;
+    img.channels[0] = r;
+    img.channels[1] = g;
+    img.channels[2] = b;
+    img.channels[3] = a;
+    img.pixel_stride = sizeof(float);
+    img.row_stride = row_stride != 0 ? row_stride : width * sizeof(float);
+    img.width = width;
+    img.height = height;
+    return img;
+}
 
-            // un-filter data if needed
-            if (head.filter == uint32_t(smcube_data_filter::ByteDelta))
-            {
-                size_t lut_item_size = smcube_data_type_get_size(lut.data_type) * lut.channels;
-                uint8_t* tmp = new uint8_t[lut_data_size];
-                UnFilterByteDelta((const uint8_t*)lut.data, tmp, int(lut_item_size), lut_data_size / lut_item_size);
-                memcpy(lut.data, tmp, lut_data_size);
-                delete[] tmp;
-            }
+static bool image_contains_rect(const smcube_image& img, const smcube_rect& rc)
+{
+    if (img.channels[0] == nullptr || img.channels[1] == nullptr || img.channels[2] == nullptr)
+        return false;
+    return rc.x >= 0 && rc.y >= 0 && rc.width >= 0 && rc.height >= 0 &&
+        rc.x + rc.width <= img.width && rc.y + rc.height <= img.height;
+}
 
-            // append to luts array
-            luts->luts.push_back(lut);
-        }
+static inline float* image_pixel_ptr(const smcube_image& img, int ch, int x, int y)
+{
+    return (float*)((uint8_t*)img.channels[ch] + y * img.row_stride + x * img.pixel_stride);
+}
 
-        offset += 12 + chunk_len;
+// Apply pipeline to a horizontal span of pixels within one row.
+static void pipeline_apply_span(const smcube_pipeline& pipe, const smcube_image& src, const smcube_image& dst, int x, int y, int count)
+{
+    const float* sr = image_pixel_ptr(src, 0, x, y);
+    const float* sg = image_pixel_ptr(src, 1, x, y);
+    const float* sb = image_pixel_ptr(src, 2, x, y);
+    const float* sa = src.channels[3] ? image_pixel_ptr(src, 3, x, y) : nullptr;
+    float* dr = image_pixel_ptr(dst, 0, x, y);
+    float* dg = image_pixel_ptr(dst, 1, x, y);
+    float* db = image_pixel_ptr(dst, 2, x, y);
+    float* da = dst.channels[3] ? image_pixel_ptr(dst, 3, x, y) : nullptr;
+    const bool copy_alpha = da != nullptr && da != sa;
+
+    int i = 0;
+    if (src.pixel_stride == sizeof(float) && dst.pixel_stride == sizeof(float))
+    {
+        // planar: load 4 pixels from each channel plane, transpose into
+        // 4 RGB pixels, evaluate and transpose back
+        for (; i + 3 < count; i += 4)
+        {
+            Float4 p0 = SimdLoadF(sr + i), p1 = SimdLoadF(sg + i), p2 = SimdLoadF(sb + i), p3 = SimdZeroF();
+            SimdTransposeF(p0, p1, p2, p3);
+            p0 = pipeline_eval(pipe, p0);
+            p1 = pipeline_eval(pipe, p1);
+            p2 = pipeline_eval(pipe, p2);
+            p3 = pipeline_eval(pipe, p3);
+            SimdTransposeF(p0, p1, p2, p3);
+            SimdStoreF(dr + i, p0);
+            SimdStoreF(dg + i, p1);
+            SimdStoreF(db + i, p2);
+            if (copy_alpha)
+                SimdStoreF(da + i, sa ? SimdLoadF(sa + i) : SimdSet1F(1.0f));
+        }
     }
 
-    return luts;
+    // generic strided pixels
+    const ptrdiff_t sstride = src.pixel_stride / sizeof(float);
+    const ptrdiff_t dstride = dst.pixel_stride / sizeof(float);
+    float res[4];
+    for (; i < count; ++i)
+    {
+        SimdStoreF(res, pipeline_eval(pipe, SimdSetF(sr[i * sstride], sg[i * sstride], sb[i * sstride], 0.0f)));
+        const float alpha = sa ? sa[i * sstride] : 1.0f;
+        dr[i * dstride] = res[0];
+        dg[i * dstride] = res[1];
+        db[i * dstride] = res[2];
+        if (copy_alpha)
+            da[i * dstride] = alpha;
+    }
 }
 
-void smcube_free(smcube_luts* handle)
+// Apply pipeline to [begin, end) pixels of the rectangle, in row-major
+// order; the range can span several rows.
+static void pipeline_apply_range(const smcube_pipeline& pipe, const smcube_image& src, const smcube_image& dst, const smcube_rect& rc, size_t begin, size_t end)
 {
-    if (handle)
-        delete[] handle->file_data;
-    delete handle;
+    const size_t width = rc.width;
+    while (begin < end)
+    {
+        const size_t y = begin / width;
+        const size_t x = begin % width;
+        const size_t count = std::min(width - x, end - begin);
+        pipeline_apply_span(pipe, src, dst, rc.x + int(x), rc.y + int(y), int(count));
+        begin += count;
+    }
 }
 
-#if !defined(NO_FLOAT_FROM_CHARS_HERE)
-static inline bool is_whitespace(char c)
+void smcube_pipeline_apply_image(const smcube_pipeline* pipe, const smcube_image* src, const smcube_image* dst, const smcube_rect* roi)
 {
-    return c <= ' ';
+    if (pipe == nullptr || src == nullptr || dst == nullptr)
+        return;
+    smcube_rect rc = roi != nullptr ? *roi : smcube_rect{ 0, 0, src->width, src->height };
+    if (!image_contains_rect(*src, rc) || !image_contains_rect(*dst, rc))
+        return;
+    if (src->pixel_stride % sizeof(float) != 0 || dst->pixel_stride % sizeof(float) != 0)
+        return;
+
+    // split all the pixels of the rectangle into chunks, that can span rows
+    parallel_for(size_t(rc.width) * rc.height, 16 * 1024, [&](size_t begin, size_t end)
+    {
+        pipeline_apply_range(*pipe, *src, *dst, rc, begin, end);
+    });
 }
 
-static const char* skip_whitespace(const char* p, const char* end)
+// --------------------------------------------------------------------------
+// Batch application
+
+static const size_t kBatchTilePixels = 16 * 1024;
+
+// Range of tile indices still to be processed by one worker. Begin and end
+// are packed into one atomic, so that the owner taking tiles from the front
+// and other workers stealing half of the range from the back never get the
+// same tile.
+struct alignas(64) batch_tile_range
 {
-    while (p < end && is_whitespace(*p))
-        ++p;
-    return p;
-}
+    std::atomic<uint64_t> range;
+};
 
-static const char* skip_plus(const char* p, const char* end)
+static inline uint64_t batch_pack_range(uint32_t begin, uint32_t end)
 {
-    if (p < end && *p == '+')
-        ++p;
-    return p;
+    return (uint64_t(end) << 32) | begin;
 }
 
-static const char* parse_float(const char* p, const char* end, float fallback, float& dst, bool& valid)
+static bool batch_range_pop(batch_tile_range& r, uint32_t& tile)
 {
-    p = skip_whitespace(p, end);
-    p = skip_plus(p, end);
-    std::from_chars_result res = std::from_chars(p, end, dst);
-    if (res.ec == std::errc::invalid_argument || res.ec == std::errc::result_out_of_range) {
-        dst = fallback;
-        valid = false;
-    }
-    else if (res.ptr < end && !is_whitespace(*res.ptr)) {
-        // If there are trailing non-space characters, it is not a valid number
-        dst = fallback;
-        valid = false;
-        return p;
+    uint64_t v = r.range.load();
+    while (true)
+    {
+        uint32_t begin = uint32_t(v), end = uint32_t(v >> 32);
+        if (begin >= end)
+            return false;
+        if (r.range.compare_exchange_weak(v, batch_pack_range(begin + 1, end)))
+        {
+            tile = begin;
+            return true;
+        }
     }
-    return res.ptr;
 }
 
-static bool parse_3floats(const char* p, const char* end, float* dst)
+static bool batch_range_steal(batch_tile_range& r, uint32_t& dst_begin, uint32_t& dst_end)
 {
-    bool valid = true;
-    for (int i = 0; i < 3; ++i)
-        p = parse_float(p, end, 0.0f, dst[i], valid);
-    return valid;
+    uint64_t v = r.range.load();
+    while (true)
+    {
+        uint32_t begin = uint32_t(v), end = uint32_t(v >> 32);
+        if (begin >= end)
+            return false;
+        uint32_t mid = begin + (end - begin) / 2;
+        if (r.range.compare_exchange_weak(v, batch_pack_range(begin, mid)))
+        {
+            dst_begin = mid;
+            dst_end = end;
+            return true;
+        }
+    }
 }
 
-#else
-
-static bool parse_3floats(const char* p, const char* end, float* dst)
+static bool batch_job_is_valid(const smcube_batch_job& job)
 {
-    int count = sscanf(p, "%f %f %f", dst+0, dst+1, dst+2);
-    return count == 3;
+    if (job.pipe == nullptr)
+        return false;
+    smcube_rect rc = { 0, 0, job.src.width, job.src.height };
+    if (!image_contains_rect(job.src, rc) || !image_contains_rect(job.dst, rc))
+        return false;
+    return job.src.pixel_stride % sizeof(float) == 0 && job.dst.pixel_stride % sizeof(float) == 0;
 }
 
-#endif
+bool smcube_pipeline_apply_batch(const smcube_batch_job* jobs, size_t job_count, int thread_count)
+{
+    if (jobs == nullptr)
+        return job_count == 0;
+
+    // tile_starts[i] is index of the first tile of job i; all the tiles of
+    // all jobs form one [0, tile_count) range
+    bool all_valid = true;
+    std::vector<uint32_t> tile_starts(job_count + 1);
+    std::vector<std::atomic<uint32_t>> tiles_left(job_count);
+    uint32_t tile_count = 0;
+    for (size_t i = 0; i < job_count; ++i)
+    {
+        tile_starts[i] = tile_count;
+        uint32_t tiles = 0;
+        if (batch_job_is_valid(jobs[i]))
+        {
+            size_t pixels = size_t(jobs[i].src.width) * jobs[i].src.height;
+            tiles = uint32_t((pixels + kBatchTilePixels - 1) / kBatchTilePixels);
+            if (tiles == 0 && jobs[i].on_done)
+                jobs[i].on_done(i, jobs[i].user_data);
+        }
+        else
+            all_valid = false;
+        tiles_left[i].store(tiles);
+        tile_count += tiles;
+    }
+    tile_starts[job_count] = tile_count;
 
+    auto process_tile = [&](uint32_t tile)
+    {
+        size_t job_index = std::upper_bound(tile_starts.begin(), tile_starts.end(), tile) - tile_starts.begin() - 1;
+        const smcube_batch_job& job = jobs[job_index];
+        const smcube_rect rc = { 0, 0, job.src.width, job.src.height };
+        const size_t begin = (tile - tile_starts[job_index]) * kBatchTilePixels;
+        const size_t end = std::min(begin + kBatchTilePixels, size_t(rc.width) * rc.height);
+        pipeline_apply_range(*job.pipe, job.src, job.dst, rc, begin, end);
+        if (tiles_left[job_index].fetch_sub(1) == 1 && job.on_done)
+            job.on_done(job_index, job.user_data);
+    };
 
-// Resolve .cube file format notes:
-// https://resolve.cafe/developers/luts/
+    // each worker starts with an equal share of tiles, and once out of
+    // them, steals half of the remaining tiles of another worker
+    size_t worker_count = thread_count > 0 ? size_t(thread_count) : std::thread::hardware_concurrency();
+    worker_count = std::max<size_t>(1, std::min<size_t>(worker_count, tile_count));
+    std::vector<batch_tile_range> ranges(worker_count);
+    for (size_t i = 0; i < worker_count; ++i)
+        ranges[i].range.store(batch_pack_range(uint32_t(tile_count * i / worker_count), uint32_t(tile_count * (i + 1) / worker_count)));
 
-smcube_luts* smcube_load_from_file_resolve_cube(const char* path)
+    auto worker = [&](size_t index)
+    {
+        while (true)
+        {
+            uint32_t tile;
+            if (batch_range_pop(ranges[index], tile))
+            {
+                process_tile(tile);
+                continue;
+            }
+            // only the owner ever stores into its range, and only when it
+            // is empty (thieves do not modify empty ranges)
+            bool stolen = false;
+            for (size_t k = 1; k < worker_count && !stolen; ++k)
+            {
+                uint32_t begin, end;
+                if (batch_range_steal(ranges[(index + k) % worker_count], begin, end))
+                {
+                    ranges[index].range.store(batch_pack_range(begin, end));
+                    stolen = true;
+                }
+            }
+            if (!stolen)
+                break;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(worker_count - 1);
+    for (size_t i = 1; i < worker_count; ++i)
+        threads.emplace_back(worker, i);
+    worker(0);
+    for (std::thread& t : threads)
+        t.join();
+    return all_valid;
+}
+
+// --------------------------------------------------------------------------
+// LUT resampling
+
+smcube_luts* smcube_resample_3d(const smcube_luts* handle, int size_x, int size_y, int size_z, smcube_interpolation interp)
 {
-    if (path == nullptr)
+    if (handle == nullptr || size_x < 2 || size_y < 2 || size_z < 2 || size_x > 4096 || size_y > 4096 || size_z > 4096)
         return nullptr;
-
-    FILE* f = fopen(path, "rb");
-    if (f == nullptr)
+    if (interp >= smcube_interpolation::InterpolationCount)
         return nullptr;
 
-    char buf[1000] = {};
-    std::string title;
-
-    // read header
-    int dim_3d = 0, dim_1d = 0;
-    while (true) {
-        char* res = fgets(buf, sizeof(buf)-1, f);
-        if (!res)
-            break;
-        if (buf[0] >= '+' && buf[0] <= '9') // line starts with a number: header is done
-            break;
-        int tmp;
-        if (1 == sscanf(buf, "LUT_1D_SIZE %i", &tmp))
+    // 3D LUTs get new sizes, others are kept as is
+    smcube_luts* res = new smcube_luts();
+    res->title = handle->title;
+    res->comment = handle->comment;
+    res->luts = handle->luts;
+    std::vector<size_t> data_offsets;
+    for (smcube_lut& lut : res->luts)
+    {
+        if (lut.dimension == 3)
         {
-            dim_1d = tmp;
+            lut.size_x = size_x;
+            lut.size_y = size_y;
+            lut.size_z = size_z;
         }
-        if (1 == sscanf(buf, "LUT_3D_SIZE %i", &tmp))
+        data_offsets.push_back(res->file_data_size);
+        res->file_data_size += lut_get_data_size(lut);
+    }
+    res->file_data = alloc_file_data(res->file_data_size);
+
+    for (size_t index = 0; index < res->luts.size(); ++index)
+    {
+        smcube_lut& lut = res->luts[index];
+        lut.data = res->file_data + data_offsets[index];
+        if (lut.dimension != 3)
         {
-            dim_3d = tmp;
+            memcpy(lut.data, handle->luts[index].data, lut_get_data_size(lut));
+            continue;
         }
-        if (strncmp(buf, "TITLE ", 6) == 0)
+
+        lut_stage st;
+        lut_stage_init(st, handle, index);
+        // sample the source LUT in its own 0..size-1 coordinate space
+        for (int ch = 0; ch < 3; ++ch)
         {
-            title = buf + 6;
-            while (!title.empty() && title.back() <= ' ')
-                title.pop_back(); // strip trailing newlines/spaces
-            // strip quotes at start/end
-            if (!title.empty() && title.front() == '"')
-                title = title.substr(1);
-            if (!title.empty() && title.back() == '"')
-                title.pop_back();
+            st.coord_scale[ch] = 1.0f;
+            st.coord_bias[ch] = 0.0f;
         }
+        const float scale[3] = {
+            float(st.size_x - 1) / float(size_x - 1),
+            float(st.size_y - 1) / float(size_y - 1),
+            float(st.size_z - 1) / float(size_z - 1),
+        };
 
-        //@TODO: comment
+        // each output Z slice independently
+        const int channels = lut.channels;
+        const size_t slice_items = size_t(size_x) * size_y;
+        parallel_for(size_z, 1, [&](size_t begin, size_t end)
+        {
+            std::vector<float> slice(slice_items * channels);
+            float tmp[4];
+            for (size_t z = begin; z < end; ++z)
+            {
+                float* dst = slice.data();
+                for (int y = 0; y < size_y; ++y)
+                {
+                    for (int x = 0; x < size_x; ++x)
+                    {
+                        Float4 c = SimdSetF(x * scale[0], y * scale[1], z * scale[2], 0.0f);
+                        Float4 v = st.data_type == smcube_data_type::Float16 ?
+                            lut_stage_eval_3d_interp<uint16_t>(st, c, interp) :
+                            lut_stage_eval_3d_interp<float>(st, c, interp);
+                        SimdStoreF(tmp, v);
+                        memcpy(dst, tmp, channels * sizeof(float));
+                        dst += channels;
+                    }
+                }
+                const size_t slice_values = slice_items * channels;
+                if (lut.data_type == smcube_data_type::Float16)
+                    float_to_half(slice.data(), (uint16_t*)lut.data + z * slice_values, slice_values);
+                else
+                    memcpy((float*)lut.data + z * slice_values, slice.data(), slice_values * sizeof(float));
+            }
+        });
     }
+    return res;
+}
 
-    // validate header
-    if (dim_1d < 0 || dim_1d > 65536 || dim_3d < 0 || dim_3d > 4096 || (dim_1d == 0 && dim_3d == 0))
+// --------------------------------------------------------------------------
+// Minimal LUT size search
+
+// Copy of LUTs, with all Float32 3D LUTs converted to Float16.
+static smcube_luts* luts_clone_3d_as_half(const smcube_luts* handle)
+{
+    smcube_luts* res = new smcube_luts();
+    res->title = handle->title;
+    res->comment = handle->comment;
+    res->luts = handle->luts;
+    std::vector<size_t> data_offsets;
+    for (smcube_lut& lut : res->luts)
     {
-        fclose(f);
-        return nullptr;
+        if (lut.dimension == 3)
+            lut.data_type = smcube_data_type::Float16;
+        data_offsets.push_back(res->file_data_size);
+        res->file_data_size += lut_get_data_size(lut);
     }
-
-    // allocate memory for the data
-    size_t floats_1d = dim_1d > 0 ? dim_1d * 3 : 0;
-    size_t floats_3d = dim_3d > 0 ? dim_3d * dim_3d * dim_3d * 3 : 0;
-
-    smcube_luts* luts = new smcube_luts();
-    luts->title = title;
-    luts->file_data_size = (floats_1d + floats_3d) * sizeof(float);
-    luts->file_data = new uint8_t[luts->file_data_size];
-
-    smcube_lut lut1d, lut3d;
-    if (dim_1d > 0)
+    res->file_data = alloc_file_data(res->file_data_size);
+    for (size_t index = 0; index < res->luts.size(); ++index)
     {
-        lut1d.channels = 3;
-        lut1d.dimension = 1;
-        lut1d.data_type = smcube_data_type::Float32;
-        lut1d.size_x = dim_1d;
-        lut1d.size_y = 1;
-        lut1d.size_z = 1;
-        lut1d.data = luts->file_data;
-        luts->luts.push_back(lut1d);
+        smcube_lut& lut = res->luts[index];
+        const smcube_lut& src = handle->luts[index];
+        lut.data = res->file_data + data_offsets[index];
+        if (lut.data_type != src.data_type)
+            float_to_half((const float*)src.data, (uint16_t*)lut.data, lut_get_data_size(lut) / sizeof(uint16_t));
+        else
+            memcpy(lut.data, src.data, lut_get_data_size(lut));
     }
-    if (dim_3d > 0)
+    return res;
+}
+
+// Measure max and mean difference of all 3D LUTs of a candidate from the
+// original ones, at grid points of the original LUTs.
+static void measure_3d_error(const smcube_luts* original, const smcube_luts* candidate, float& max_error, float& mean_error)
+{
+    max_error = 0.0f;
+    double error_sum = 0.0;
+    size_t error_count = 0;
+    for (size_t index = 0; index < original->luts.size(); ++index)
     {
-        lut3d.channels = 3;
-        lut3d.dimension = 3;
-        lut3d.data_type = smcube_data_type::Float32;
-        lut3d.size_x = dim_3d;
-        lut3d.size_y = dim_3d;
-        lut3d.size_z = dim_3d;
-        lut3d.data = luts->file_data + floats_1d * sizeof(float);
-        luts->luts.push_back(lut3d);
+        if (original->luts[index].dimension != 3)
+            continue;
+        lut_stage orig, cand;
+        lut_stage_init(orig, original, index);
+        lut_stage_init(cand, candidate, index);
+        // sample candidate in 0..1 space
+        for (int ch = 0; ch < 3; ++ch)
+        {
+            cand.coord_scale[ch] = cand.coord_max[ch];
+            cand.coord_bias[ch] = 0.0f;
+        }
+
+        std::vector<float> slice_max(orig.size_z, 0.0f);
+        std::vector<double> slice_sum(orig.size_z, 0.0);
+        parallel_for(orig.size_z, 1, [&](size_t begin, size_t end)
+        {
+            float tmp[4];
+            for (size_t z = begin; z < end; ++z)
+            {
+                Float4 max_err = SimdZeroF();
+                double sum = 0.0;
+                for (int y = 0; y < orig.size_y; ++y)
+                {
+                    for (int x = 0; x < orig.size_x; ++x)
+                    {
+                        Float4 v = orig.data_type == smcube_data_type::Float16 ?
+                            lut_stage_fetch<uint16_t>(orig, x, y, int(z)) :
+                            lut_stage_fetch<float>(orig, x, y, int(z));
+                        Float4 c = SimdSetF(
+                            orig.size_x > 1 ? x / float(orig.size_x - 1) : 0.0f,
+                            orig.size_y > 1 ? y / float(orig.size_y - 1) : 0.0f,
+                            orig.size_z > 1 ? z / float(orig.size_z - 1) : 0.0f,
+                            0.0f);
+                        Float4 diff = SimdSubF(lut_stage_eval(cand, c), v);
+                        diff = SimdMaxF(diff, SimdSubF(SimdZeroF(), diff));
+                        max_err = SimdMaxF(max_err, diff);
+                        SimdStoreF(tmp, diff);
+                        sum += tmp[0] + tmp[1] + tmp[2];
+                    }
+                }
+                SimdStoreF(tmp, max_err);
+                slice_max[z] = std::max(tmp[0], std::max(tmp[1], tmp[2]));
+                slice_sum[z] = sum;
+            }
+        });
+        for (int z = 0; z < orig.size_z; ++z)
+        {
+            max_error = std::max(max_error, slice_max[z]);
+            error_sum += slice_sum[z];
+        }
+        error_count += size_t(orig.size_x) * orig.size_y * orig.size_z * 3;
+    }
+    mean_error = error_count > 0 ? float(error_sum / error_count) : 0.0f;
+}
+
+smcube_luts* smcube_minimize_3d(const smcube_luts* handle, float max_error, float mean_error, smcube_interpolation interp, smcube_minimize_result* dst_result)
+{
+    if (dst_result != nullptr)
+        *dst_result = smcube_minimize_result();
+    if (handle == nullptr)
+        return nullptr;
+    int max_size = 0;
+    bool has_float32 = false;
+    for (const smcube_lut& lut : handle->luts)
+    {
+        if (lut.dimension != 3)
+            continue;
+        max_size = std::max(max_size, std::max(lut.size_x, std::max(lut.size_y, lut.size_z)));
+        has_float32 |= lut.data_type == smcube_data_type::Float32;
     }
+    if (max_size < 2)
+        return nullptr;
+    const smcube_data_type data_type_3d = has_float32 ? smcube_data_type::Float32 : smcube_data_type::Float16;
 
-    // read data
-    size_t read_1d = 0, read_3d = 0;
-    while (true) {
-        // note: first data line is already in buf
-        float xyz[3];
-        bool xyzvalid = parse_3floats(buf, buf + strlen(buf), xyz);
-        if (xyzvalid)
+    // Go through sizes from smallest; at each size try Float16 then Float32
+    // data. Pick the smallest file that fits within error tolerance. Once even
+    // a Float16 LUT of some size is larger than the best one so far, larger
+    // sizes can not be better.
+    smcube_luts* best = nullptr;
+    smcube_minimize_result best_res = {};
+    int candidates = 0;
+    for (int size = 2; size <= max_size; ++size)
+    {
+        smcube_luts* resampled = smcube_resample_3d(handle, size, size, size, interp);
+        if (resampled == nullptr)
+            break;
+        smcube_luts* cands[2] = { has_float32 ? luts_clone_3d_as_half(resampled) : nullptr, resampled };
+        bool done = false;
+        for (smcube_luts* cand : cands)
         {
-            if (dim_1d > 0 && read_1d < dim_1d)
+            if (cand == nullptr)
+                continue;
+            const size_t file_size = smcube_calc_file_size_smcube(cand, smcube_save_flag_None);
+            if (best != nullptr && file_size >= best_res.file_size)
             {
-                ((float*)lut1d.data)[read_1d * 3 + 0] = xyz[0];
-                ((float*)lut1d.data)[read_1d * 3 + 1] = xyz[1];
-                ((float*)lut1d.data)[read_1d * 3 + 2] = xyz[2];
-                ++read_1d;
+                // only gets larger from here
+                done = cand == cands[0] || cands[0] == nullptr;
+                smcube_free(cand);
+                continue;
             }
-            else if (dim_3d > 0 && read_3d < dim_3d * dim_3d * dim_3d)
+            ++candidates;
+            float cand_max, cand_mean;
+            measure_3d_error(handle, cand, cand_max, cand_mean);
+            if (cand_max <= max_error && cand_mean <= mean_error)
             {
-                ((float*)lut3d.data)[read_3d * 3 + 0] = xyz[0];
-                ((float*)lut3d.data)[read_3d * 3 + 1] = xyz[1];
-                ((float*)lut3d.data)[read_3d * 3 + 2] = xyz[2];
-                ++read_3d;
+                smcube_free(best);
+                best = cand;
+                best_res.size = size;
+                best_res.data_type = cand == cands[0] ? smcube_data_type::Float16 : data_type_3d;
+                best_res.max_error = cand_max;
+                best_res.mean_error = cand_mean;
+                best_res.file_size = file_size;
             }
             else
             {
-                fclose(f);
-                smcube_free(luts);
-                return nullptr;
+                smcube_free(cand);
             }
         }
-
-        // read next data line
-        char* res = fgets(buf, sizeof(buf), f);
-        if (!res)
+        if (done)
             break;
     }
+    best_res.candidates = candidates;
+    if (dst_result != nullptr)
+        *dst_result = best_res;
+    return best;
+}
 
-    fclose(f);
+// --------------------------------------------------------------------------
+// YUV 4:2:0 image application
 
-    if (dim_1d > 0 && read_1d != dim_1d || dim_3d > 0 && read_3d != dim_3d * dim_3d * dim_3d)
+static bool yuv_format_is_wide(smcube_yuv_format format)
+{
+    return format == smcube_yuv_format::P010 || format == smcube_yuv_format::I010;
+}
+
+static bool yuv_format_is_planar(smcube_yuv_format format)
+{
+    return format == smcube_yuv_format::I420 || format == smcube_yuv_format::I010;
+}
+
+smcube_yuv_image smcube_image_yuv(smcube_yuv_format format, void* data, int width, int height)
+{
+    smcube_yuv_image img;
+    if (data == nullptr || format >= smcube_yuv_format::FormatCount || width <= 0 || height <= 0)
+        return img;
+    const int sample_size = yuv_format_is_wide(format) ? 2 : 1;
+    const int chroma_width = (width + 1) / 2, chroma_height = (height + 1) / 2;
+    img.format = format;
+    img.width = width;
+    img.height = height;
+    img.planes[0] = data;
+    img.row_strides[0] = width * sample_size;
+    img.planes[1] = (uint8_t*)data + img.row_strides[0] * height;
+    if (yuv_format_is_planar(format))
     {
-        smcube_free(luts);
-        return nullptr;
+        img.row_strides[1] = img.row_strides[2] = chroma_width * sample_size;
+        img.planes[2] = (uint8_t*)img.planes[1] + img.row_strides[1] * chroma_height;
     }
-    return luts;
+    else
+    {
+        img.row_strides[1] = chroma_width * 2 * sample_size;
+    }
+    return img;
 }
 
-static bool is_lut_supported_by_resolve_cube(const smcube_lut& lut)
+struct yuv_layout
 {
-    if (lut.channels != 3 || lut.data_type != smcube_data_type::Float32 || (lut.dimension != 1 && lut.dimension != 3))
+    uint8_t* y = nullptr;
+    uint8_t* u = nullptr;
+    uint8_t* v = nullptr;
+    ptrdiff_t y_stride = 0, u_stride = 0, v_stride = 0;
+    int uv_step = 1;    // samples between adjacent U (or V) values
+    bool wide = false;  // 16 bit samples
+    int shift = 0;      // position of the value within 16 bit sample
+    int max_value = 255;
+    // sample value -> normalized: v * scale + bias
+    float y_scale = 0.0f, y_bias = 0.0f, c_scale = 0.0f, c_bias = 0.0f;
+};
+
+static bool yuv_layout_init(const smcube_yuv_image& img, yuv_layout& l)
+{
+    if (img.format >= smcube_yuv_format::FormatCount || img.matrix >= smcube_yuv_matrix::MatrixCount || img.width <= 0 || img.height <= 0)
         return false;
-    if (lut.dimension == 3 && (lut.size_x != lut.size_y || lut.size_x != lut.size_z || lut.size_y != lut.size_z))
+    const bool planar = yuv_format_is_planar(img.format);
+    if (img.planes[0] == nullptr || img.planes[1] == nullptr || (planar && img.planes[2] == nullptr))
         return false;
+    l.wide = yuv_format_is_wide(img.format);
+    l.shift = img.format == smcube_yuv_format::P010 ? 6 : 0;
+    l.max_value = l.wide ? 1023 : 255;
+    const int sample_size = l.wide ? 2 : 1;
+    l.y = (uint8_t*)img.planes[0];
+    l.y_stride = img.row_strides[0];
+    l.u = (uint8_t*)img.planes[1];
+    l.u_stride = img.row_strides[1];
+    l.v = planar ? (uint8_t*)img.planes[2] : l.u + sample_size;
+    l.v_stride = planar ? img.row_strides[2] : img.row_strides[1];
+    l.uv_step = planar ? 1 : 2;
+
+    const float f = l.wide ? 4.0f : 1.0f;
+    if (img.full_range)
+    {
+        l.y_scale = l.c_scale = 1.0f / l.max_value;
+        l.y_bias = 0.0f;
+        l.c_bias = -128.0f * f * l.c_scale;
+    }
+    else
+    {
+        l.y_scale = 1.0f / (219.0f * f);
+        l.y_bias = -16.0f * f * l.y_scale;
+        l.c_scale = 1.0f / (224.0f * f);
+        l.c_bias = -128.0f * f * l.c_scale;
+    }
     return true;
 }
 
-bool smcube_save_to_file_resolve_cube(const char* path, const smcube_luts* luts)
+static inline float yuv_read(const uint8_t* row, int idx, const yuv_layout& l)
 {
-    // argument checks
-    if (path == nullptr || luts == nullptr || luts->luts.empty())
-        return false;
+    if (l.wide)
+    {
+        uint16_t v;
+        memcpy(&v, row + idx * 2, 2);
+        return float(v >> l.shift);
+    }
+    return float(row[idx]);
+}
 
-    FILE* f = fopen(path, "wb");
-    if (f == nullptr)
-        return false;
+static inline void yuv_write(uint8_t* row, int idx, float v, const yuv_layout& l)
+{
+    int iv = int(v + 0.5f);
+    iv = iv < 0 ? 0 : (iv > l.max_value ? l.max_value : iv);
+    if (l.wide)
+    {
+        uint16_t v16 = uint16_t(iv << l.shift);
+        memcpy(row + idx * 2, &v16, 2);
+    }
+    else
+    {
+        row[idx] = uint8_t(iv);
+    }
+}
 
-    // write header
-    fprintf(f, "# written by smol-cube\n");
-    if (!luts->title.empty())
-        fprintf(f, "TITLE \"%s\"\n", luts->title.c_str());
-    //@TODO: comment
-    for (const smcube_lut& lut : luts->luts)
+// YUV <-> RGB matrix, for normalized Y in 0..1 and U, V in -0.5..0.5.
+struct yuv_matrix
+{
+    float u_to_rgb[4], v_to_rgb[4];
+    float rgb_to_y[4], rgb_to_u[4], rgb_to_v[4];
+};
+
+static void yuv_matrix_init(smcube_yuv_matrix matrix, yuv_matrix& m)
+{
+    float kr = 0.2126f, kb = 0.0722f; // BT.709
+    if (matrix == smcube_yuv_matrix::BT601)
     {
-        if (!is_lut_supported_by_resolve_cube(lut))
-            continue;
-        if (lut.dimension == 1)
-            fprintf(f, "LUT_1D_SIZE %i\n", lut.size_x);
-        if (lut.dimension == 3)
-            fprintf(f, "LUT_3D_SIZE %i\n", lut.size_x);
+        kr = 0.299f;
+        kb = 0.114f;
+    }
+    else if (matrix == smcube_yuv_matrix::BT2020)
+    {
+        kr = 0.2627f;
+        kb = 0.0593f;
     }
+    const float kg = 1.0f - kr - kb;
+    const float cr = 2.0f * (1.0f - kr), cb = 2.0f * (1.0f - kb);
+    const float u_to_rgb[4] = { 0.0f, -cb * kb / kg, cb, 0.0f };
+    const float v_to_rgb[4] = { cr, -cr * kr / kg, 0.0f, 0.0f };
+    const float rgb_to_y[4] = { kr, kg, kb, 0.0f };
+    const float rgb_to_u[4] = { -kr / cb, -kg / cb, (1.0f - kb) / cb, 0.0f };
+    const float rgb_to_v[4] = { (1.0f - kr) / cr, -kg / cr, -kb / cr, 0.0f };
+    memcpy(m.u_to_rgb, u_to_rgb, sizeof(u_to_rgb));
+    memcpy(m.v_to_rgb, v_to_rgb, sizeof(v_to_rgb));
+    memcpy(m.rgb_to_y, rgb_to_y, sizeof(rgb_to_y));
+    memcpy(m.rgb_to_u, rgb_to_u, sizeof(rgb_to_u));
+    memcpy(m.rgb_to_v, rgb_to_v, sizeof(rgb_to_v));
+}
 
-    // write data
-    for (const smcube_lut& lut : luts->luts)
+static inline float dot3(const float* a, const float* b)
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+// Process one chroma row (two luma rows) of YUV image, in tiles along X.
+// Chroma is upsampled with MPEG-2 siting (co-sited horizontally, halfway
+// between luma rows vertically), converted to RGB, LUT applied, and written
+// out either as RGB floats, or converted back to YUV (chroma of each 2x2
+// pixel block averaged).
+static void yuv_apply_row_pair(const smcube_pipeline& pipe, const yuv_layout& sl, const yuv_matrix& sm, int width, int height, int cy,
+    const smcube_image* dst_rgb, const yuv_layout* dl, const yuv_matrix* dm)
+{
+    const int kTile = 256;
+    const int chroma_width = (width + 1) / 2, chroma_height = (height + 1) / 2;
+    float u_rows[2][kTile / 2 + 1], v_rows[2][kTile / 2 + 1];
+    Float4 acc[kTile / 2];
+    float res[4];
+
+    const uint8_t* u_prev = sl.u + std::max(cy - 1, 0) * sl.u_stride;
+    const uint8_t* u_cur = sl.u + cy * sl.u_stride;
+    const uint8_t* u_next = sl.u + std::min(cy + 1, chroma_height - 1) * sl.u_stride;
+    const uint8_t* v_prev = sl.v + std::max(cy - 1, 0) * sl.v_stride;
+    const uint8_t* v_cur = sl.v + cy * sl.v_stride;
+    const uint8_t* v_next = sl.v + std::min(cy + 1, chroma_height - 1) * sl.v_stride;
+    const Float4 u_to_rgb = SimdLoadF(sm.u_to_rgb);
+    const Float4 v_to_rgb = SimdLoadF(sm.v_to_rgb);
+    const int rows = std::min(2, height - cy * 2);
+
+    for (int x0 = 0; x0 < width; x0 += kTile)
     {
-        if (!is_lut_supported_by_resolve_cube(lut))
-            continue;
-        const float* data = (const float*)lut.data;
-        const float* data_end = data + lut_get_data_size(lut) / sizeof(float);
-        while (data < data_end)
+        const int x1 = std::min(x0 + kTile, width);
+        // vertically filtered chroma for upper and lower luma rows
+        const int cx0 = x0 / 2;
+        const int cx1 = std::min(x1 / 2, chroma_width - 1);
+        for (int cx = cx0; cx <= cx1; ++cx)
         {
-            fprintf(f, "%.8f %.8f %.8f\n", data[0], data[1], data[2]);
-            data += 3;
+            const int idx = cx * sl.uv_step;
+            const float uc = yuv_read(u_cur, idx, sl) * sl.c_scale + sl.c_bias;
+            const float vc = yuv_read(v_cur, idx, sl) * sl.c_scale + sl.c_bias;
+            u_rows[0][cx - cx0] = uc * 0.75f + (yuv_read(u_prev, idx, sl) * sl.c_scale + sl.c_bias) * 0.25f;
+            v_rows[0][cx - cx0] = vc * 0.75f + (yuv_read(v_prev, idx, sl) * sl.c_scale + sl.c_bias) * 0.25f;
+            u_rows[1][cx - cx0] = uc * 0.75f + (yuv_read(u_next, idx, sl) * sl.c_scale + sl.c_bias) * 0.25f;
+            v_rows[1][cx - cx0] = vc * 0.75f + (yuv_read(v_next, idx, sl) * sl.c_scale + sl.c_bias) * 0.25f;
+        }
+        if (dl != nullptr)
+        {
+            for (int i = 0; i < (x1 - x0 + 1) / 2; ++i)
+                acc[i] = SimdZeroF();
+        }
+
+        for (int row = 0; row < rows; ++row)
+        {
+            const int y = cy * 2 + row;
+            const uint8_t* src_y = sl.y + y * sl.y_stride;
+            uint8_t* dst_y = dl != nullptr ? dl->y + y * dl->y_stride : nullptr;
+            const float* ur = u_rows[row];
+            const float* vr = v_rows[row];
+            for (int x = x0; x < x1; ++x)
+            {
+                const int ci = (x >> 1) - cx0;
+                float u = ur[ci], v = vr[ci];
+                if (x & 1)
+                {
+                    const int cn = std::min((x >> 1) + 1, cx1) - cx0;
+                    u = (u + ur[cn]) * 0.5f;
+                    v = (v + vr[cn]) * 0.5f;
+                }
+                const float luma = yuv_read(src_y, x, sl) * sl.y_scale + sl.y_bias;
+                Float4 c = SimdAddF(SimdSet1F(luma), SimdAddF(SimdMulF(SimdSet1F(u), u_to_rgb), SimdMulF(SimdSet1F(v), v_to_rgb)));
+                c = pipeline_eval(pipe, c);
+                if (dl != nullptr)
+                {
+                    SimdStoreF(res, c);
+                    yuv_write(dst_y, x, (dot3(res, dm->rgb_to_y) - dl->y_bias) / dl->y_scale, *dl);
+                    acc[(x - x0) >> 1] = SimdAddF(acc[(x - x0) >> 1], c);
+                }
+                else
+                {
+                    SimdStoreF(res, c);
+                    *image_pixel_ptr(*dst_rgb, 0, x, y) = res[0];
+                    *image_pixel_ptr(*dst_rgb, 1, x, y) = res[1];
+                    *image_pixel_ptr(*dst_rgb, 2, x, y) = res[2];
+                    if (dst_rgb->channels[3] != nullptr)
+                        *image_pixel_ptr(*dst_rgb, 3, x, y) = 1.0f;
+                }
+            }
+        }
+
+        if (dl != nullptr)
+        {
+            uint8_t* dst_u = dl->u + cy * dl->u_stride;
+            uint8_t* dst_v = dl->v + cy * dl->v_stride;
+            for (int x = x0; x < x1; x += 2)
+            {
+                const int count = rows * std::min(2, x1 - x);
+                SimdStoreF(res, SimdMulF(acc[(x - x0) >> 1], SimdSet1F(1.0f / count)));
+                const int idx = (x >> 1) * dl->uv_step;
+                yuv_write(dst_u, idx, (dot3(res, dm->rgb_to_u) - dl->c_bias) / dl->c_scale, *dl);
+                yuv_write(dst_v, idx, (dot3(res, dm->rgb_to_v) - dl->c_bias) / dl->c_scale, *dl);
+            }
         }
     }
+}
 
-    fclose(f);
-    return true;
+void smcube_pipeline_apply_yuv_to_rgb(const smcube_pipeline* pipe, const smcube_yuv_image* src, const smcube_image* dst)
+{
+    yuv_layout sl;
+    if (pipe == nullptr || src == nullptr || dst == nullptr || !yuv_layout_init(*src, sl))
+        return;
+    if (!image_contains_rect(*dst, smcube_rect{ 0, 0, src->width, src->height }))
+        return;
+    yuv_matrix sm;
+    yuv_matrix_init(src->matrix, sm);
+    parallel_for((src->height + 1) / 2, 4, [&](size_t begin, size_t end)
+    {
+        for (size_t cy = begin; cy < end; ++cy)
+            yuv_apply_row_pair(*pipe, sl, sm, src->width, src->height, int(cy), dst, nullptr, nullptr);
+    });
 }
 
-void smcube_lut_convert_data(const smcube_luts* handle, size_t index, smcube_data_type dst_type, int dst_channels, void* dst_data)
+void smcube_pipeline_apply_yuv(const smcube_pipeline* pipe, const smcube_yuv_image* src, const smcube_yuv_image* dst)
 {
-    if (handle == nullptr || index >= handle->luts.size())
+    yuv_layout sl, dl;
+    if (pipe == nullptr || src == nullptr || dst == nullptr || !yuv_layout_init(*src, sl) || !yuv_layout_init(*dst, dl))
         return;
-    if (dst_data == nullptr || dst_type >= smcube_data_type::DataTypeCount || dst_channels < 1 || dst_channels > 4)
+    if (src->width != dst->width || src->height != dst->height)
         return;
+    yuv_matrix sm, dm;
+    yuv_matrix_init(src->matrix, sm);
+    yuv_matrix_init(dst->matrix, dm);
+    parallel_for((src->height + 1) / 2, 4, [&](size_t begin, size_t end)
+    {
+        for (size_t cy = begin; cy < end; ++cy)
+            yuv_apply_row_pair(*pipe, sl, sm, src->width, src->height, int(cy), nullptr, &dl, &dm);
+    });
+}
 
-    const smcube_lut& lut = handle->luts[index];
-    const size_t data_items = lut.size_x * lut.size_y * lut.size_z;
-    const size_t src_item_size = smcube_data_type_get_size(lut.data_type) * lut.channels;
+// --------------------------------------------------------------------------
+// Fixed point LUT for packed 10 bit formats
 
-    if (dst_type == lut.data_type && dst_channels == lut.channels) {
-        // no conversion needed, just copy
-        memcpy(dst_data, lut.data, data_items * src_item_size);
-        return;
-    }
+// Inputs are 12 bit RGB integers (0..4095 maps to 0..1); 10 bit values are
+// expanded to that by bit replication, while YUV->RGB conversion produces
+// them directly, with extra precision. LUT coordinates have 15 fractional
+// bits, and LUT data is 16 bit unorm RGBA.
+struct smcube_fixed_lut
+{
+    int size_x = 0, size_y = 0, size_z = 0;
+    int coord_mul[4] = {}; // input -> LUT coordinate: (v * mul + add) >> 8
+    int coord_add[4] = {};
+    int coord_max[4] = {}; // (size-1) << 15
+    int cell_max[4] = {};  // size-2
+    int step_x = 0, step_y = 0, step_z = 0; // data offsets to next item along X/Y/Z, or zero if size is 1
+    std::vector<uint16_t> data;
+};
 
-    const int copy_channels = lut.channels < dst_channels ? lut.channels : dst_channels;
-    const int skip_channels = lut.channels - copy_channels;
-    const int zero_channels = dst_channels - copy_channels;
+static const int kFixedInputMax = 4095;
 
-    if (lut.data_type == smcube_data_type::Float16)
+smcube_fixed_lut* smcube_fixed_lut_create(const smcube_luts* handle, size_t index)
+{
+    if (handle == nullptr || index >= handle->luts.size())
+        return nullptr;
+    const smcube_lut& lut = handle->luts[index];
+    if (lut.dimension != 3)
+        return nullptr;
+
+    smcube_fixed_lut* res = new smcube_fixed_lut();
+    res->size_x = lut.size_x;
+    res->size_y = lut.size_y;
+    res->size_z = lut.size_z;
+    const int sizes[3] = { lut.size_x, lut.size_y, lut.size_z };
+    for (int ch = 0; ch < 3; ++ch)
     {
-        // source is FP16
-        const uint16_t* src = (const uint16_t*)lut.data;
-        if (dst_type == smcube_data_type::Float32)
+        const double range = lut.domain_max[ch] - lut.domain_min[ch];
+        const double scale = range != 0.0 ? (sizes[ch] - 1) / range : 0.0;
+        const double mul = scale * 32768.0 * 256.0 / kFixedInputMax;
+        const double add = -lut.domain_min[ch] * scale * 32768.0 * 256.0;
+        // inputs can be somewhat out of 0..4095 range (out of gamut YUV);
+        // the domain has to be such that this does not overflow
+        const double lo = -kFixedInputMax * mul + add, hi = 2 * kFixedInputMax * mul + add;
+        if (std::max(fabs(lo), fabs(hi)) >= 2147483647.0)
         {
-            // FP16 -> FP32
-            float* dst = (float*)dst_data;
-            for (size_t i = 0; i < data_items; ++i)
-            {
-                for (int ch = 0; ch < copy_channels; ++ch)
-                    *dst++ = half_to_float(*src++);
-                for (int ch = 0; ch < zero_channels; ++ch)
-                    *dst++ = 0;
-                src += skip_channels;
-            }
+            delete res;
+            return nullptr;
         }
-        else if (dst_type == smcube_data_type::Float16)
+        res->coord_mul[ch] = int(mul + 0.5);
+        res->coord_add[ch] = int(add < 0 ? add - 0.5 : add + 0.5);
+        res->coord_max[ch] = (sizes[ch] - 1) << 15;
+        res->cell_max[ch] = sizes[ch] > 1 ? sizes[ch] - 2 : 0;
+    }
+    res->step_x = res->size_x > 1 ? 4 : 0;
+    res->step_y = res->size_y > 1 ? res->size_x * 4 : 0;
+    res->step_z = res->size_z > 1 ? res->size_x * res->size_y * 4 : 0;
+
+    const size_t values = size_t(lut.size_x) * lut.size_y * lut.size_z * 4;
+    std::vector<float> data_f(values);
+    smcube_lut_convert_data(handle, index, smcube_data_type::Float32, 4, data_f.data());
+    res->data.resize(values);
+    for (size_t i = 0; i < values; ++i)
+        res->data[i] = uint16_t(clamp01(data_f[i]) * 65535.0f + 0.5f);
+    return res;
+}
+
+void smcube_fixed_lut_free(smcube_fixed_lut* lut)
+{
+    delete lut;
+}
+
+size_t smcube_fixed_lut_get_memory_size(const smcube_fixed_lut* lut)
+{
+    if (lut == nullptr)
+        return 0;
+    return sizeof(*lut) + lut->data.size() * sizeof(lut->data[0]);
+}
+
+// a + (b - a) * t, with t having 15 fractional bits; a, b are 16 bit
+static inline Int4 SimdLerpFixed15(Int4 a, Int4 b, Int4 t)
+{
+    return SimdAddI(a, SimdShiftRightI<15>(SimdMulI(SimdSubI(b, a), t)));
+}
+
+// Trilinear lookup of one 12 bit RGB pixel; result is 16 bit RGBA.
+static inline Int4 fixed_lut_eval(const smcube_fixed_lut& lut, Int4 c)
+{
+    Int4 coord = SimdShiftRightI<8>(SimdAddI(SimdMulI(c, SimdLoadI(lut.coord_mul)), SimdLoadI(lut.coord_add)));
+    coord = SimdMinI(SimdMaxI(coord, SimdSet1I(0)), SimdLoadI(lut.coord_max));
+    Int4 cell = SimdMinI(SimdShiftRightI<15>(coord), SimdLoadI(lut.cell_max));
+    Int4 frac = SimdSubI(coord, SimdShiftLeftI<15>(cell));
+    const uint16_t* p = lut.data.data() +
+        ((size_t(SimdGetLaneI<2>(cell)) * lut.size_y + SimdGetLaneI<1>(cell)) * lut.size_x + SimdGetLaneI<0>(cell)) * 4;
+    const int sx = lut.step_x, sy = lut.step_y, sz = lut.step_z;
+    Int4 fx = SimdSplatI<0>(frac);
+    Int4 fy = SimdSplatI<1>(frac);
+    Int4 fz = SimdSplatI<2>(frac);
+    Int4 c00 = SimdLerpFixed15(SimdLoadU16x4(p), SimdLoadU16x4(p + sx), fx);
+    Int4 c10 = SimdLerpFixed15(SimdLoadU16x4(p + sy), SimdLoadU16x4(p + sy + sx), fx);
+    Int4 c01 = SimdLerpFixed15(SimdLoadU16x4(p + sz), SimdLoadU16x4(p + sz + sx), fx);
+    Int4 c11 = SimdLerpFixed15(SimdLoadU16x4(p + sz + sy), SimdLoadU16x4(p + sz + sy + sx), fx);
+    Int4 c0 = SimdLerpFixed15(c00, c10, fy);
+    Int4 c1 = SimdLerpFixed15(c01, c11, fy);
+    return SimdLerpFixed15(c0, c1, fz);
+}
+
+// 16 bit -> 10 bit, rounded
+static inline Int4 fixed_16_to_10(Int4 v)
+{
+    return SimdShiftRightLogicalI<16>(SimdAddI(SimdMulI(v, SimdSet1I(1023)), SimdSet1I(32768)));
+}
+
+// Four RGB10A2 pixels: unpack, apply, repack. Alpha bits are kept.
+static inline void fixed_lut_apply_rgb10a2_4(const smcube_fixed_lut& lut, const uint32_t* src, uint32_t* dst)
+{
+    const Int4 w = SimdLoadI(src);
+    const Int4 mask = SimdSet1I(0x3FF);
+    Int4 r = SimdAndI(w, mask);
+    Int4 g = SimdAndI(SimdShiftRightLogicalI<10>(w), mask);
+    Int4 b = SimdAndI(SimdShiftRightLogicalI<20>(w), mask);
+    // 10 -> 12 bit by replicating the high bits
+    r = SimdOrI(SimdShiftLeftI<2>(r), SimdShiftRightLogicalI<8>(r));
+    g = SimdOrI(SimdShiftLeftI<2>(g), SimdShiftRightLogicalI<8>(g));
+    b = SimdOrI(SimdShiftLeftI<2>(b), SimdShiftRightLogicalI<8>(b));
+    Int4 p0 = r, p1 = g, p2 = b, p3 = SimdSet1I(0);
+    SimdTransposeI(p0, p1, p2, p3);
+    p0 = fixed_lut_eval(lut, p0);
+    p1 = fixed_lut_eval(lut, p1);
+    p2 = fixed_lut_eval(lut, p2);
+    p3 = fixed_lut_eval(lut, p3);
+    SimdTransposeI(p0, p1, p2, p3);
+    Int4 res = SimdAndI(w, SimdSet1I(int(0xC0000000)));
+    res = SimdOrI(res, fixed_16_to_10(p0));
+    res = SimdOrI(res, SimdShiftLeftI<10>(fixed_16_to_10(p1)));
+    res = SimdOrI(res, SimdShiftLeftI<20>(fixed_16_to_10(p2)));
+    SimdStoreI(dst, res);
+}
+
+void smcube_fixed_lut_apply_rgb10a2(const smcube_fixed_lut* lut, const uint32_t* src, uint32_t* dst, size_t pixel_count)
+{
+    if (lut == nullptr || src == nullptr || dst == nullptr)
+        return;
+    parallel_for(pixel_count, 64 * 1024, [&](size_t begin, size_t end)
+    {
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4)
+            fixed_lut_apply_rgb10a2_4(*lut, src + i, dst + i);
+        if (i < end)
         {
-            // FP16 channels adjust
-            uint16_t* dst = (uint16_t*)dst_data;
-            for (size_t i = 0; i < data_items; ++i)
-            {
-                for (int ch = 0; ch < copy_channels; ++ch)
-                    *dst++ = *src++;
-                for (int ch = 0; ch < zero_channels; ++ch)
-                    *dst++ = 0;
-                src += skip_channels;
-            }
+            uint32_t tmp[4] = {};
+            memcpy(tmp, src + i, (end - i) * sizeof(tmp[0]));
+            fixed_lut_apply_rgb10a2_4(*lut, tmp, tmp);
+            memcpy(dst + i, tmp, (end - i) * sizeof(tmp[0]));
         }
+    });
+}
+
+// YCbCr (10 bit, video range) <-> RGB conversion constants, fixed point.
+struct fixed_yuv_matrix
+{
+    int y_to_rgb;                 // (Y-64) -> 12 bit RGB, 12 fractional bits
+    int cb_to_rgb[4], cr_to_rgb[4];
+    int rgb_to_y[3], rgb_to_cb[3], rgb_to_cr[3]; // 16 bit RGB -> 10 bit, 16 fractional bits
+};
+
+static void fixed_yuv_matrix_init(smcube_yuv_matrix matrix, fixed_yuv_matrix& m)
+{
+    yuv_matrix fm;
+    yuv_matrix_init(matrix, fm);
+    const double y_scale = kFixedInputMax / 876.0 * 4096.0;
+    const double c_scale = kFixedInputMax / 896.0 * 4096.0;
+    m.y_to_rgb = int(y_scale + 0.5);
+    for (int ch = 0; ch < 4; ++ch)
+    {
+        m.cb_to_rgb[ch] = int(lrint(fm.u_to_rgb[ch] * c_scale));
+        m.cr_to_rgb[ch] = int(lrint(fm.v_to_rgb[ch] * c_scale));
     }
-    else if (lut.data_type == smcube_data_type::Float32)
+    for (int ch = 0; ch < 3; ++ch)
     {
-        // source is FP32
-        const float* src = (const float*)lut.data;
-        if (dst_type == smcube_data_type::Float16)
+        m.rgb_to_y[ch] = int(lrint(fm.rgb_to_y[ch] * 876.0 / 65535.0 * 65536.0));
+        m.rgb_to_cb[ch] = int(lrint(fm.rgb_to_u[ch] * 896.0 / 65535.0 * 65536.0));
+        m.rgb_to_cr[ch] = int(lrint(fm.rgb_to_v[ch] * 896.0 / 65535.0 * 65536.0));
+    }
+}
+
+static inline int clamp10(int v)
+{
+    return v < 0 ? 0 : (v > 1023 ? 1023 : v);
+}
+
+// One v210 group (6 pixels in 4 words): unpack 10 bit fields of all words
+// at once, convert to RGB and apply per pixel, convert back and repack.
+// Each pixel pair shares chroma; output chroma is the average of the pair.
+static inline void fixed_lut_apply_v210_group(const smcube_fixed_lut& lut, const fixed_yuv_matrix& m, const uint8_t* src, uint8_t* dst)
+{
+    const Int4 w = SimdLoadI(src);
+    const Int4 mask = SimdSet1I(0x3FF);
+    int f[3][4];
+    SimdStoreI(f[0], SimdAndI(w, mask));
+    SimdStoreI(f[1], SimdAndI(SimdShiftRightLogicalI<10>(w), mask));
+    SimdStoreI(f[2], SimdAndI(SimdShiftRightLogicalI<20>(w), mask));
+    // word layout: Cb0 Y0 Cr0 | Y1 Cb1 Y2 | Cr1 Y3 Cb2 | Y4 Cr2 Y5
+    int* const ys[6] = { &f[1][0], &f[0][1], &f[2][1], &f[1][2], &f[0][3], &f[2][3] };
+    int* const cbs[3] = { &f[0][0], &f[1][1], &f[2][2] };
+    int* const crs[3] = { &f[2][0], &f[0][2], &f[1][3] };
+
+    const Int4 cb_to_rgb = SimdLoadI(m.cb_to_rgb);
+    const Int4 cr_to_rgb = SimdLoadI(m.cr_to_rgb);
+    int rgb[4];
+    for (int pair = 0; pair < 3; ++pair)
+    {
+        const Int4 chroma = SimdAddI(
+            SimdMulI(SimdSet1I(*cbs[pair] - 512), cb_to_rgb),
+            SimdMulI(SimdSet1I(*crs[pair] - 512), cr_to_rgb));
+        int sum[3] = {};
+        for (int i = 0; i < 2; ++i)
         {
-            // FP32 -> FP16
-            uint16_t* dst = (uint16_t*)dst_data;
-            for (size_t i = 0; i < data_items; ++i)
-            {
-                for (int ch = 0; ch < copy_channels; ++ch)
-                    *dst++ = float_to_half(*src++);
-                for (int ch = 0; ch < zero_channels; ++ch)
-                    *dst++ = 0;
-                src += skip_channels;
-            }
+            int& y = *ys[pair * 2 + i];
+            Int4 c = SimdAddI(SimdAddI(SimdSet1I((y - 64) * m.y_to_rgb), chroma), SimdSet1I(2048));
+            c = SimdMinI(SimdMaxI(SimdShiftRightI<12>(c), SimdSet1I(-kFixedInputMax)), SimdSet1I(2 * kFixedInputMax));
+            c = fixed_lut_eval(lut, c);
+            SimdStoreI(rgb, c);
+            y = clamp10(64 + ((rgb[0] * m.rgb_to_y[0] + rgb[1] * m.rgb_to_y[1] + rgb[2] * m.rgb_to_y[2] + 32768) >> 16));
+            sum[0] += rgb[0];
+            sum[1] += rgb[1];
+            sum[2] += rgb[2];
         }
-        else if (dst_type == smcube_data_type::Float32)
+        // sums of two pixels: one extra bit
+        *cbs[pair] = clamp10(512 + ((sum[0] * m.rgb_to_cb[0] + sum[1] * m.rgb_to_cb[1] + sum[2] * m.rgb_to_cb[2] + 65536) >> 17));
+        *crs[pair] = clamp10(512 + ((sum[0] * m.rgb_to_cr[0] + sum[1] * m.rgb_to_cr[1] + sum[2] * m.rgb_to_cr[2] + 65536) >> 17));
+    }
+
+    Int4 res = SimdLoadI(f[0]);
+    res = SimdOrI(res, SimdShiftLeftI<10>(SimdLoadI(f[1])));
+    res = SimdOrI(res, SimdShiftLeftI<20>(SimdLoadI(f[2])));
+    SimdStoreI(dst, res);
+}
+
+void smcube_fixed_lut_apply_v210(const smcube_fixed_lut* lut, const void* src, void* dst, int width, int height, ptrdiff_t row_stride, smcube_yuv_matrix matrix)
+{
+    if (lut == nullptr || src == nullptr || dst == nullptr || width <= 0 || height <= 0 || matrix >= smcube_yuv_matrix::MatrixCount)
+        return;
+    if (row_stride == 0)
+        row_stride = ptrdiff_t(width + 47) / 48 * 128;
+    fixed_yuv_matrix m;
+    fixed_yuv_matrix_init(matrix, m);
+    const int groups = (width + 5) / 6;
+    parallel_for(height, 4, [&](size_t begin, size_t end)
+    {
+        for (size_t y = begin; y < end; ++y)
         {
-            // FP32 channels adjust
-            float* dst = (float*)dst_data;
-            for (size_t i = 0; i < data_items; ++i)
-            {
-                for (int ch = 0; ch < copy_channels; ++ch)
-                    *dst++ = *src++;
-                for (int ch = 0; ch < zero_channels; ++ch)
-                    *dst++ = 0;
-                src += skip_channels;
-            }
+            const uint8_t* s = (const uint8_t*)src + y * row_stride;
+            uint8_t* d = (uint8_t*)dst + y * row_stride;
+            for (int g = 0; g < groups; ++g)
+                fixed_lut_apply_v210_group(*lut, m, s + g * 16, d + g * 16);
         }
-    }
+    });
 }
@@ -1,4 +1,4 @@
-﻿// SPDX-License-Identifier: MIT OR Unlicense
+// SPDX-License-Identifier: MIT OR Unlicense
 // smol-cube: https://github.com/aras-p/smol-cube
 
 #pragma once
@@ -13,6 +13,14 @@ enum class smcube_data_type
 	DataTypeCount
 };
 
+enum class smcube_interpolation
+{
+	Trilinear = 0, // Linear along each axis, between 8 cell corners (like GPUs do)
+	Tetrahedral,   // Linear between 4 corners of a tetrahedron within the cell
+	Tricubic,      // Catmull-Rom cubic along each axis, between 4x4x4 points
+	InterpolationCount
+};
+
 // Flags used in `smcube_save_to_file_smcube`.
 // They can be combined together.
 enum smcube_save_flags
@@ -34,6 +42,76 @@ enum smcube_save_flags
 	// can be faster and more convenient to load onto GPU. Since many
 	// 3D APIs do not support 3-channel textures directly.
 	smcube_save_flag_ExpandTo4Channels = (1 << 2),
+
+	// Compress LUT data with a built-in entropy coder (implies FilterData).
+	// Files get about as small as with a general purpose compressor,
+	// without needing one to load them; decompression is done together
+	// with un-filtering while loading.
+	smcube_save_flag_Compress = (1 << 3),
+
+	// Filter data with a 3D predictor (from neighbors along X, Y and Z)
+	// instead of ByteDelta that only looks along X (implies FilterData).
+	// Usually makes filtered 3D LUTs more compressible, at a small
+	// additional cost when loading.
+	smcube_save_flag_FilterPredict3D = (1 << 4),
+
+	// Store LUT data as difference from identity LUT (output equal to
+	// input), which makes near-identity LUTs more compressible (and other
+	// LUTs usually less). Values that adding identity back would not
+	// reproduce exactly are stored as they are, after the LUT data, so
+	// this is lossless. Identity is added back while loading; for
+	// compressed data to each row as soon as it is decoded. Float16 data
+	// is converted to floats and back for that.
+	smcube_save_flag_IdentityResidual = (1 << 5),
+
+	// For Float16 data, filter with deltas of whole 16 bit values instead
+	// of ByteDelta (implies FilterData). WordDelta splits the deltas into
+	// low/high byte lanes, BitShuffle into 16 bit planes. Float32 data is
+	// filtered with ByteDelta. FilterPredict3D takes precedence over these.
+	smcube_save_flag_FilterWordDelta = (1 << 6),
+	smcube_save_flag_FilterBitShuffle = (1 << 7),
+
+	// Place LUT data at 64 byte (cache line) or 4096 byte (page) aligned
+	// file offsets, by writing padding chunks before LUT chunks. Only done
+	// for LUTs that are not compressed. Memory mapped files can be used
+	// directly with SIMD code or for GPU uploads only when the data is also
+	// not filtered and not saved with IdentityResidual; otherwise it has to
+	// be decoded first. Data of loaded LUTs (compressed ones too) is at 64
+	// byte aligned addresses when saved with these flags.
+	smcube_save_flag_AlignData64 = (1 << 8),
+	smcube_save_flag_AlignDataPage = (1 << 9),
+};
+
+// Flags used in `smcube_pipeline_create`.
+// They can be combined together.
+enum smcube_pipeline_flags
+{
+	smcube_pipeline_flag_None = 0,
+
+	// Store 3D LUT data in a "bricked" memory layout, where 4x4x4 blocks
+	// of LUT cells are next to each other in memory. This makes lookups
+	// more cache and TLB friendly for large (e.g. 65^3) LUTs, at expense
+	// of about 2x more memory. Conversion is done once, when creating
+	// the pipeline.
+	smcube_pipeline_flag_BrickLayout = (1 << 0),
+
+	// Store 3D LUT data so that each LUT cell has values of all its 8
+	// corners next to each other in memory. Interpolation then needs one
+	// contiguous load instead of 8 scattered ones, at expense of about 8x
+	// more memory (0.5MB for 17^3, 4MB for 33^3 float LUT). Good for small
+	// LUTs. Takes precedence over BrickLayout if both are set.
+	smcube_pipeline_flag_CornerPackedLayout = (1 << 1),
+
+	// Remember recent results in `smcube_pipeline_apply`: a pixel equal to
+	// the previous one reuses its result, and each chunk of pixels that is
+	// processed (by one worker thread) has a small direct-mapped cache keyed
+	// on exact input color. Pixels found there skip LUT evaluation entirely.
+	// Several times faster for graphics, UI, slates or mattes with large
+	// flat areas; up to about 40% slower for photographs or noise, where few
+	// pixels repeat. Only `smcube_pipeline_apply` uses the cache; other
+	// apply functions (`_image`, `_blend`, `_batch`, `_yuv`, `_yuv_to_rgb`)
+	// ignore this flag.
+	smcube_pipeline_flag_ColorCache = (1 << 2),
 };
 
 struct smcube_luts;
@@ -65,6 +143,11 @@ void smcube_free(smcube_luts* handle);
 // Returns true if all is ok.
 bool smcube_save_to_file_smcube(const char* path, const smcube_luts* luts, smcube_save_flags flags = smcube_save_flag_None);
 
+// Calculate size of the file that `smcube_save_to_file_smcube` would write
+// with the given flags (data filtering does not change the size; with
+// compression, the data is compressed to find out). Returns 0 on failure.
+size_t smcube_calc_file_size_smcube(const smcube_luts* luts, smcube_save_flags flags = smcube_save_flag_None);
+
 // Save LUT(s) to Resolve/Adobe LUT format file.
 //
 // Note that this only supports LUTs that the Resolve format can handle:
@@ -105,6 +188,11 @@ int smcube_lut_get_size_y(const smcube_luts* handle, size_t index);
 // Get LUT size in Z dimension (only relevant for 3D LUTs).
 int smcube_lut_get_size_z(const smcube_luts* handle, size_t index);
 
+// Get input domain (range) of the LUT: three floats for minimum and
+// three for maximum input value of each channel. Default domain is 0..1;
+// 1D "shaper" LUTs often have a different one.
+void smcube_lut_get_domain(const smcube_luts* handle, size_t index, float* dst_min, float* dst_max);
+
 // Get the actual data of the LUT.
 //
 // Data is laid out in row-major order, i.e. X dimension (which usually
@@ -132,3 +220,334 @@ size_t smcube_data_type_get_size(smcube_data_type type);
 // space for `size_x * size_y * size_z * dst_channels` numbers of
 // `dst_type` format.
 void smcube_lut_convert_data(const smcube_luts* handle, size_t index, smcube_data_type dst_type, int dst_channels, void* dst_data);
+
+// Convert an array of floats into half-precision floats (given as raw
+// 16 bit values), or back. Uses SIMD instructions when available.
+void smcube_float_to_half(const float* src, uint16_t* dst, size_t count);
+void smcube_half_to_float(const uint16_t* src, float* dst, size_t count);
+
+// "Baked" LUT for 8 bit/channel inputs.
+//
+// Expands a 3D LUT into a table that has an entry for every possible
+// 24 bit RGB input value (256x256x256 RGBA8 entries, 64MB of memory).
+// Applying it is then a single memory load per pixel, with no
+// interpolation at all. Good for high volume 8 bit/channel workloads
+// where the memory cost is acceptable.
+struct smcube_baked_lut8;
+
+// Create baked LUT out of a 3D LUT at given index.
+// Building is done in parallel using multiple threads.
+// Returns nullptr if LUT is not 3D or index is invalid.
+smcube_baked_lut8* smcube_baked_lut8_create(const smcube_luts* handle, size_t index);
+
+// Delete the baked LUT.
+void smcube_baked_lut8_free(smcube_baked_lut8* baked);
+
+// Get memory used by the baked LUT, in bytes.
+size_t smcube_baked_lut8_get_memory_size(const smcube_baked_lut8* baked);
+
+// Get time it took to build the baked LUT, in milliseconds.
+double smcube_baked_lut8_get_build_time(const smcube_baked_lut8* baked);
+
+// Apply baked LUT to 8 bit/channel pixels.
+//
+// Pixels are either RGB (channels=3) or RGBA (channels=4); alpha
+// is passed through unchanged. Source and destination can be the
+// same buffer.
+void smcube_baked_lut8_apply(const smcube_baked_lut8* baked, const uint8_t* src, uint8_t* dst, size_t pixel_count, int channels);
+
+// Baked 1D LUT for half-float (Float16) inputs.
+//
+// Expands a 1D LUT (e.g. a shaper or transfer function) into tables that
+// have an entry for every possible 16 bit half-float input value (65536
+// Float16 entries per channel, 512KB of memory). Applying it is then a
+// single memory load per channel, with no interpolation. Good for RGBA16F
+// render buffers.
+struct smcube_baked_lut1d_half;
+
+// Create baked LUT out of a 1D LUT at given index.
+// Building is done in parallel using multiple threads.
+// Returns nullptr if LUT is not 1D or index is invalid.
+smcube_baked_lut1d_half* smcube_baked_lut1d_half_create(const smcube_luts* handle, size_t index);
+
+// Delete the baked LUT.
+void smcube_baked_lut1d_half_free(smcube_baked_lut1d_half* baked);
+
+// Get memory used by the baked LUT, in bytes.
+size_t smcube_baked_lut1d_half_get_memory_size(const smcube_baked_lut1d_half* baked);
+
+// Get time it took to build the baked LUT, in milliseconds.
+double smcube_baked_lut1d_half_get_build_time(const smcube_baked_lut1d_half* baked);
+
+// Apply baked LUT to half-float pixels (given as raw 16 bit values).
+//
+// Pixels are either RGB (channels=3) or RGBA (channels=4); alpha
+// is passed through unchanged. Source and destination can be the
+// same buffer. On CPUs with AVX2, lookups are done 8 at a time with
+// gather instructions (detected at runtime with GCC/Clang; MSVC builds
+// need /arch:AVX2 for that).
+void smcube_baked_lut1d_half_apply(const smcube_baked_lut1d_half* baked, const uint16_t* src, uint16_t* dst, size_t pixel_count, int channels);
+
+// CPU LUT application pipeline.
+//
+// Evaluates all the LUTs from the file in order (e.g. a 1D shaper LUT
+// followed by a 3D LUT), taking their input domains into account. All the
+// LUTs are evaluated for each pixel in a single pass over the image,
+// using SIMD and multiple threads.
+struct smcube_pipeline;
+
+// Create LUT application pipeline out of all 1D, 2D and 3D LUTs in the file.
+// Flags control internal data layout.
+// The pipeline keeps its own copy of the data; LUTs handle can be
+// deleted afterwards. Float16 LUTs are kept in half precision (half the
+// memory and cache footprint), and converted to floats when sampled.
+smcube_pipeline* smcube_pipeline_create(const smcube_luts* handle, smcube_pipeline_flags flags = smcube_pipeline_flag_None);
+
+// Delete the pipeline.
+void smcube_pipeline_free(smcube_pipeline* pipe);
+
+// Set which input channels (0=R, 1=G, 2=B) index the X and Y axes of 2D
+// LUT at given index, e.g. hue/saturation or luminance/chroma grids.
+// If pass_through is set, the remaining third channel keeps its input
+// value; otherwise all channels come from the LUT. By default 2D LUTs
+// are indexed by R and G, without pass-through.
+//
+// Returns false if LUT at index is not a 2D one, or channels are invalid.
+bool smcube_pipeline_set_2d_inputs(smcube_pipeline* pipe, size_t index, int channel_x, int channel_y, bool pass_through);
+
+// Apply the pipeline to floating point pixels.
+//
+// Pixels are either RGB (channels=3) or RGBA (channels=4); alpha
+// is passed through unchanged. Source and destination can be the
+// same buffer.
+void smcube_pipeline_apply(const smcube_pipeline* pipe, const float* src, float* dst, size_t pixel_count, int channels);
+
+// Apply the pipeline(s) and blend the results, in a single pass.
+//
+// If pipe_b is null, the result is blended between input pixels and the
+// result of pipe_a, i.e. `lerp(src, a(src), factor)` (LUT intensity).
+// Otherwise, it is a crossfade between the two pipelines, i.e.
+// `lerp(a(src), b(src), factor)`. Factor is not clamped. Alpha and
+// channel handling is the same as in `smcube_pipeline_apply`.
+void smcube_pipeline_apply_blend(const smcube_pipeline* pipe_a, const smcube_pipeline* pipe_b, float factor, const float* src, float* dst, size_t pixel_count, int channels);
+
+// Bake all 1D, 2D and 3D LUTs from the file (e.g. a 1D shaper LUT followed
+// by a 3D LUT) into a single 3D LUT of given size.
+//
+// The chain is resampled at the grid points of the new LUT, in parallel
+// over Z slices. The new LUT covers input domain of the first LUT in the
+// chain, and has 3 channel 32 bit float data. Using the result needs only
+// a single 3D texture / single lookup.
+//
+// If dst_max_error is not null, it receives the maximum difference
+// between the new LUT and exact chain evaluation (measured at centers
+// of the new LUT grid cells).
+//
+// Returns a new LUT handle (free it with `smcube_free`), or nullptr
+// in case of failure.
+smcube_luts* smcube_bake_to_3d(const smcube_luts* handle, int size, float* dst_max_error = nullptr);
+
+// Same as `smcube_bake_to_3d`, except the new LUT covers the given input
+// domain (3 floats each for min and max) instead of the chain domain; e.g.
+// 0..1 when the result is sampled as a texture with plain 0..1 coordinates.
+smcube_luts* smcube_bake_to_3d_domain(const smcube_luts* handle, int size, const float* domain_min, const float* domain_max, float* dst_max_error = nullptr);
+
+// Bake blend of LUTs (see `smcube_pipeline_apply_blend`) with a fixed
+// factor into a single 3D LUT of given size, so that applying it later
+// needs just one lookup. If handle_b is null, this is a blend between
+// identity and handle_a LUTs. The new LUT covers input domains of both.
+//
+// Returns a new LUT handle (free it with `smcube_free`), or nullptr
+// in case of failure.
+smcube_luts* smcube_bake_blend_to_3d(const smcube_luts* handle_a, const smcube_luts* handle_b, float factor, int size);
+
+// Description of a floating point image buffer for LUT application.
+//
+// Each of R, G, B (and optionally A) channels has its own base pointer,
+// so both interleaved (RGBRGB...) and planar (RRR...GGG...BBB...) layouts,
+// with any padding, can be described. Value of channel `c` for pixel at
+// (x, y) is at `(uint8_t*)channels[c] + y * row_stride + x * pixel_stride`.
+// Pixel stride must be a multiple of float size.
+struct smcube_image
+{
+	float* channels[4] = {};    // R, G, B, A; A is optional and can be nullptr
+	ptrdiff_t pixel_stride = 0; // bytes between adjacent pixels of a row
+	ptrdiff_t row_stride = 0;   // bytes between adjacent rows
+	int width = 0;
+	int height = 0;
+};
+
+// Image rectangle (region of interest).
+struct smcube_rect
+{
+	int x, y, width, height;
+};
+
+// Describe an interleaved image with 3 (RGB) or 4 (RGBA) float channels,
+// with no padding between rows.
+smcube_image smcube_image_interleaved(float* data, int width, int height, int channels);
+
+// Describe a planar image, with each channel in a separate float plane.
+// Alpha plane is optional (can be nullptr). Row stride is in bytes;
+// zero means no padding between rows.
+smcube_image smcube_image_planar(float* r, float* g, float* b, float* a, int width, int height, ptrdiff_t row_stride = 0);
+
+// Apply the pipeline to pixels of a source image, writing them into
+// destination image. Both images can have different layouts (e.g. planar
+// source and interleaved destination). If region of interest is not null,
+// only pixels within it are processed; the rectangle is the same for both
+// images and has to be within both of them.
+//
+// Alpha is copied from source if both images have it; destination alpha
+// is set to 1.0 if only destination has it. Planar images (pixel stride of
+// one float) are processed with a faster code path. Source and destination
+// can be the same image.
+void smcube_pipeline_apply_image(const smcube_pipeline* pipe, const smcube_image* src, const smcube_image* dst, const smcube_rect* roi = nullptr);
+
+// One image of a batch passed to `smcube_pipeline_apply_batch`.
+struct smcube_batch_job
+{
+	const smcube_pipeline* pipe = nullptr; // pipeline to apply to this image
+	smcube_image src;                      // source image
+	smcube_image dst;                      // destination image, at least as large as source
+	// Optional callback, called once all pixels of the job are done. It is
+	// called on one of the worker threads (possibly the calling one).
+	void (*on_done)(size_t job_index, void* user_data) = nullptr;
+	void* user_data = nullptr;
+};
+
+// Apply pipelines to a batch of images, e.g. thousands of thumbnails
+// together with a few huge images.
+//
+// All images are split into tiles of similar pixel counts, and the tiles
+// are scheduled on a work-stealing pool of threads, so that neither small
+// images leave threads idle nor large ones are under-split. Thread count of
+// zero means all CPU cores. Returns once all jobs are done.
+//
+// Jobs with a null pipeline or invalid images are skipped (and their
+// callbacks are not called); returns false if there were any.
+bool smcube_pipeline_apply_batch(const smcube_batch_job* jobs, size_t job_count, int thread_count = 0);
+
+// Resample all 3D LUTs from the file into a different size.
+//
+// E.g. shrink 65^3 LUT into 33^3 one to save memory, or enlarge 17^3 one
+// into 65^3. Data type, channels and input domain of the LUTs are kept;
+// non-3D LUTs (e.g. 1D shaper) are copied as is. Resampling is done
+// in parallel over Z slices of the output. Each new size has to be at
+// least 2.
+//
+// Returns a new LUT handle (free it with `smcube_free`), or nullptr
+// in case of failure.
+smcube_luts* smcube_resample_3d(const smcube_luts* handle, int size_x, int size_y, int size_z, smcube_interpolation interp = smcube_interpolation::Trilinear);
+
+// Result of `smcube_minimize_3d`.
+struct smcube_minimize_result
+{
+	int size = 0;             // chosen NxNxN size of 3D LUTs
+	smcube_data_type data_type = smcube_data_type::Float32; // chosen data type of 3D LUTs
+	float max_error = 0.0f;   // maximum difference from original LUTs
+	float mean_error = 0.0f;  // average difference from original LUTs
+	size_t file_size = 0;     // size of resulting .smcube file
+	int candidates = 0;       // how many candidate LUTs were evaluated
+};
+
+// Find the smallest 3D LUT that still represents the original one(s)
+// within given error tolerance.
+//
+// Candidate sizes from 2 up to the original size are produced with
+// `smcube_resample_3d` (using the given interpolation), both as Float32
+// and Float16 data (unless the original is already Float16). Each candidate
+// is evaluated with trilinear interpolation at all grid points of the
+// original LUT, and the error is the absolute per-channel difference. Out
+// of candidates where maximum and mean errors are within tolerance, the one
+// resulting in the smallest .smcube file is picked. Error measurement is
+// done in parallel.
+//
+// Non-3D LUTs in the file are kept as is. Returns a new LUT handle (free it
+// with `smcube_free`) and fills in the result. Returns nullptr if there are
+// no 3D LUTs (result `candidates` is then zero), or if no candidate is within
+// tolerance, e.g. when a non-cubic LUT resampled to NxNxN sizes can't match
+// the original closely enough (result `candidates` is non-zero).
+smcube_luts* smcube_minimize_3d(const smcube_luts* handle, float max_error, float mean_error, smcube_interpolation interp = smcube_interpolation::Trilinear, smcube_minimize_result* dst_result = nullptr);
+
+// YUV 4:2:0 image formats (chroma at half resolution in both directions).
+enum class smcube_yuv_format
+{
+	NV12 = 0, // 8 bit; Y plane followed by interleaved UV plane
+	P010,     // 10 bit in high bits of 16 bit samples; Y plane, interleaved UV plane
+	I420,     // 8 bit; separate Y, U, V planes
+	I010,     // 10 bit in low bits of 16 bit samples; separate Y, U, V planes
+	FormatCount
+};
+
+// YUV <-> RGB conversion matrix.
+enum class smcube_yuv_matrix
+{
+	BT601 = 0,
+	BT709,
+	BT2020,
+	MatrixCount
+};
+
+// Description of a YUV 4:2:0 image.
+struct smcube_yuv_image
+{
+	void* planes[3] = {};          // Y, U (or interleaved UV), V (unused for NV12/P010)
+	ptrdiff_t row_strides[3] = {}; // bytes between adjacent rows of each plane
+	int width = 0;
+	int height = 0;
+	smcube_yuv_format format = smcube_yuv_format::NV12;
+	smcube_yuv_matrix matrix = smcube_yuv_matrix::BT709;
+	bool full_range = false;       // full 0..255 range instead of "video" 16..235 one
+};
+
+// Make YUV image description of given format, for tightly packed planes
+// following each other in memory (as usually produced by video decoders).
+smcube_yuv_image smcube_image_yuv(smcube_yuv_format format, void* data, int width, int height);
+
+// Apply the pipeline to a YUV image, writing RGB result.
+//
+// In one tiled pass, chroma is upsampled (MPEG-2 style siting: horizontally
+// co-sited with even luma pixels, vertically between luma rows), converted
+// to RGB with image's matrix and range, and the LUTs are applied. Destination
+// has to be at least as large as the source; its alpha (if any) is set to 1.0.
+void smcube_pipeline_apply_yuv_to_rgb(const smcube_pipeline* pipe, const smcube_yuv_image* src, const smcube_image* dst);
+
+// Apply the pipeline to a YUV image, writing YUV result.
+//
+// Same as `smcube_pipeline_apply_yuv_to_rgb`, except the result is converted
+// back into YUV (chroma of each 2x2 pixel block is averaged). Source and
+// destination can have different formats or matrices, but have to be the
+// same size, and can not be the same image.
+void smcube_pipeline_apply_yuv(const smcube_pipeline* pipe, const smcube_yuv_image* src, const smcube_yuv_image* dst);
+
+// Fixed point 3D LUT for packed 10 bit formats.
+//
+// Holds LUT data as 16 bit integers, and interpolates in fixed point (12 bit
+// inputs, 15 bit fractions), with pixels unpacked, processed and repacked
+// in SIMD registers, without intermediate float buffers. LUT results are
+// clamped to 0..1 range.
+struct smcube_fixed_lut;
+
+// Create fixed point LUT out of a 3D LUT at given index.
+// Returns nullptr if LUT is not 3D, index is invalid, or LUT input domain
+// can not be represented in fixed point.
+smcube_fixed_lut* smcube_fixed_lut_create(const smcube_luts* handle, size_t index);
+
+// Delete the fixed point LUT.
+void smcube_fixed_lut_free(smcube_fixed_lut* lut);
+
+// Get memory used by the fixed point LUT, in bytes.
+size_t smcube_fixed_lut_get_memory_size(const smcube_fixed_lut* lut);
+
+// Apply to RGB10A2 pixels (R in lowest 10 bits, then G, B, and 2 bit alpha
+// in the highest bits). Alpha is passed through unchanged. Source and
+// destination can be the same buffer.
+void smcube_fixed_lut_apply_rgb10a2(const smcube_fixed_lut* lut, const uint32_t* src, uint32_t* dst, size_t pixel_count);
+
+// Apply to v210 (10 bit 4:2:2 YCbCr, video range, 6 pixels packed into
+// each 16 bytes) image. Row stride of zero means the default v210 stride
+// (rows padded to 48 pixels, i.e. 128 bytes). Each pixel pair shares
+// chroma, on output it is the average of both pixels. Source and
+// destination can be the same buffer.
+void smcube_fixed_lut_apply_v210(const smcube_fixed_lut* lut, const void* src, void* dst, int width, int height, ptrdiff_t row_stride, smcube_yuv_matrix matrix);
@@ -0,0 +1,420 @@
+// SPDX-License-Identifier: MIT OR Unlicense
+// smol-cube: https://github.com/aras-p/smol-cube
+
+#include "smol_cube.h"
+
+#include "../libs/argh/argh.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+enum class frame_format
+{
+	RGB24,   // 3x uint8
+	RGB48,   // 3x uint16, little endian
+	RGBAF16, // 4x half float, little endian
+	RGBF32,  // 3x float, little endian
+};
+
+struct format_desc
+{
+	const char* name;
+	frame_format format;
+	int channels;
+	int bytes_per_pixel;
+	bool pfm_header;
+};
+
+static const format_desc kFormats[] = {
+	{ "rgb24", frame_format::RGB24, 3, 3, false },
+	{ "rgb48", frame_format::RGB48, 3, 6, false },
+	{ "rgbaf16", frame_format::RGBAF16, 4, 8, false },
+	{ "rgbf32", frame_format::RGBF32, 3, 12, false },
+	{ "pfm", frame_format::RGBF32, 3, 12, true },
+};
+
+// Horizontal strip of a frame; the buffer is sized for the largest strip.
+struct strip
+{
+	std::vector<uint8_t> data;
+	size_t pixel_count = 0;
+};
+
+// Blocking queue that passes strips between pipeline stages;
+// null strip signals end of stream.
+class strip_queue
+{
+public:
+	void push(strip* s)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_strips.push_back(s);
+		}
+		m_cond.notify_one();
+	}
+	strip* pop()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_cond.wait(lock, [&]() { return !m_strips.empty(); });
+		strip* s = m_strips.front();
+		m_strips.pop_front();
+		return s;
+	}
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	std::deque<strip*> m_strips;
+};
+
+static double get_time_ms(std::chrono::steady_clock::time_point t0)
+{
+	std::chrono::duration<double, std::milli> dt = std::chrono::steady_clock::now() - t0;
+	return dt.count();
+}
+
+// Convert a span of pixels to floats, apply the LUTs and convert back, in
+// small chunks that stay in L1 cache.
+static void apply_span(const smcube_pipeline* pipe, const format_desc& fmt, uint8_t* data, size_t pixel_count)
+{
+	const size_t kChunk = 1024;
+	float tmp[kChunk * 4];
+	const int channels = fmt.channels;
+	for (size_t begin = 0; begin < pixel_count; begin += kChunk)
+	{
+		const size_t count = std::min(kChunk, pixel_count - begin);
+		const size_t values = count * channels;
+		uint8_t* ptr = data + begin * fmt.bytes_per_pixel;
+		switch (fmt.format)
+		{
+		case frame_format::RGB24:
+			for (size_t i = 0; i < values; ++i)
+				tmp[i] = ptr[i] * (1.0f / 255.0f);
+			break;
+		case frame_format::RGB48:
+			for (size_t i = 0; i < values; ++i)
+			{
+				uint16_t v;
+				memcpy(&v, ptr + i * 2, 2);
+				tmp[i] = v * (1.0f / 65535.0f);
+			}
+			break;
+		case frame_format::RGBAF16:
+			smcube_half_to_float((const uint16_t*)ptr, tmp, values);
+			break;
+		case frame_format::RGBF32:
+			memcpy(tmp, ptr, values * sizeof(float));
+			break;
+		}
+
+		// small enough to be processed on the calling thread
+		smcube_pipeline_apply(pipe, tmp, tmp, count, channels);
+
+		switch (fmt.format)
+		{
+		case frame_format::RGB24:
+			for (size_t i = 0; i < values; ++i)
+				ptr[i] = uint8_t(std::min(std::max(tmp[i], 0.0f), 1.0f) * 255.0f + 0.5f);
+			break;
+		case frame_format::RGB48:
+			for (size_t i = 0; i < values; ++i)
+			{
+				uint16_t v = uint16_t(std::min(std::max(tmp[i], 0.0f), 1.0f) * 65535.0f + 0.5f);
+				memcpy(ptr + i * 2, &v, 2);
+			}
+			break;
+		case frame_format::RGBAF16:
+			smcube_float_to_half(tmp, (uint16_t*)ptr, values);
+			break;
+		case frame_format::RGBF32:
+			memcpy(ptr, tmp, values * sizeof(float));
+			break;
+		}
+	}
+}
+
+// Applies LUTs to whole strips, split into pixel ranges across threads.
+// Worker threads are created once and wait for the next strip, instead
+// of being created for every strip.
+class strip_workers
+{
+public:
+	strip_workers(const smcube_pipeline* pipe, const format_desc& fmt, int thread_count)
+		: m_pipe(pipe), m_fmt(fmt), m_thread_count(thread_count)
+	{
+		for (int i = 1; i < thread_count; ++i)
+			m_threads.emplace_back([this, i]() { worker(i); });
+	}
+	~strip_workers()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_quit = true;
+		}
+		m_start_cond.notify_all();
+		for (std::thread& t : m_threads)
+			t.join();
+	}
+	void apply(strip& f)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_strip = &f;
+			m_pending = int(m_threads.size());
+			++m_generation;
+		}
+		m_start_cond.notify_all();
+		apply_part(f, 0);
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_done_cond.wait(lock, [&]() { return m_pending == 0; });
+	}
+private:
+	void apply_part(strip& f, int index)
+	{
+		const size_t chunk = (f.pixel_count + m_thread_count - 1) / m_thread_count;
+		const size_t begin = chunk * index;
+		if (begin < f.pixel_count)
+			apply_span(m_pipe, m_fmt, f.data.data() + begin * m_fmt.bytes_per_pixel, std::min(chunk, f.pixel_count - begin));
+	}
+	void worker(int index)
+	{
+		uint64_t generation = 0;
+		while (true)
+		{
+			strip* f;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_start_cond.wait(lock, [&]() { return m_quit || m_generation != generation; });
+				if (m_quit)
+					return;
+				generation = m_generation;
+				f = m_strip;
+			}
+			apply_part(*f, index);
+			bool last;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				last = --m_pending == 0;
+			}
+			if (last)
+				m_done_cond.notify_one();
+		}
+	}
+
+	const smcube_pipeline* m_pipe;
+	const format_desc& m_fmt;
+	const int m_thread_count;
+	std::vector<std::thread> m_threads;
+	std::mutex m_mutex;
+	std::condition_variable m_start_cond, m_done_cond;
+	strip* m_strip = nullptr;
+	uint64_t m_generation = 0;
+	int m_pending = 0;
+	bool m_quit = false;
+};
+
+// Reads "PF" (RGB float) PFM header from the input, and passes it through
+// to the output. Only little endian files (negative scale) are supported.
+static bool read_pfm_header(FILE* in, FILE* out, int& width, int& height)
+{
+	char magic[3] = {};
+	float scale = 0.0f;
+	if (fscanf(in, "%2s %i %i %f", magic, &width, &height, &scale) != 4 || strcmp(magic, "PF") != 0)
+	{
+		fprintf(stderr, "ERROR: input is not an RGB PFM file\n");
+		return false;
+	}
+	if (scale >= 0.0f)
+	{
+		fprintf(stderr, "ERROR: big endian PFM files are not supported\n");
+		return false;
+	}
+	fgetc(in); // single whitespace character before pixel data
+	fprintf(out, "PF\n%i %i\n%g\n", width, height, scale);
+	return true;
+}
+
+int main(int argc, const char** argv)
+{
+	argh::parser args(argc, argv);
+	if (args.pos_args().size() != 2 || args["help"])
+	{
+		fprintf(stderr, "Usage: smol-cube-apply --width=<W> --height=<H> [flags] <LUT file>\n");
+		fprintf(stderr, "\n");
+		fprintf(stderr, "Reads raw frames from stdin, applies .cube/.smcube LUT to them and writes\n");
+		fprintf(stderr, "them to stdout, e.g.\n");
+		fprintf(stderr, "  ffmpeg -i in.mov -f rawvideo -pix_fmt rgb48le - |\n");
+		fprintf(stderr, "  smol-cube-apply --width=3840 --height=2160 --format=rgb48 lut.cube |\n");
+		fprintf(stderr, "  ffmpeg -f rawvideo -pix_fmt rgb48le -s 3840x2160 -i - out.mov\n");
+		fprintf(stderr, "Frames are processed in horizontal strips, so memory usage does not depend\n");
+		fprintf(stderr, "on the frame height.\n");
+		fprintf(stderr, "Flags:\n");
+		fprintf(stderr, "\n");
+		fprintf(stderr, "--width=<W>     Frame width\n");
+		fprintf(stderr, "--height=<H>    Frame height\n");
+		fprintf(stderr, "--format=<F>    Pixel format: rgb24 (default), rgb48 (16 bit little endian), rgbaf16 (half float),\n");
+		fprintf(stderr, "                rgbf32 (32 bit float) or pfm (PFM file, size is taken from its header)\n");
+		fprintf(stderr, "--rows=<N>      Rows in one strip (default 256)\n");
+		fprintf(stderr, "--threads=<N>   Threads used to apply the LUT (default: all CPU cores)\n");
+		fprintf(stderr, "--verbose       Print timing statistics at the end\n");
+		return 1;
+	}
+
+	int width = 0, height = 0, strip_rows = 256;
+	int thread_count = int(std::thread::hardware_concurrency());
+	args("width", 0) >> width;
+	args("height", 0) >> height;
+	args("rows", strip_rows) >> strip_rows;
+	args("threads", thread_count) >> thread_count;
+	const bool verbose = args["verbose"];
+	if (thread_count < 1)
+		thread_count = 1;
+	if (strip_rows < 1)
+		strip_rows = 1;
+	const std::string format_name = args("format", "rgb24").str();
+	const format_desc* fmt = nullptr;
+	for (const format_desc& desc : kFormats)
+	{
+		if (format_name == desc.name)
+			fmt = &desc;
+	}
+	if (fmt == nullptr)
+	{
+		fprintf(stderr, "ERROR: unknown pixel format '%s'\n", format_name.c_str());
+		return 1;
+	}
+
+	const std::string& lut_file = args.pos_args()[1];
+	smcube_luts* luts = smcube_load_from_file(lut_file.c_str());
+	if (luts == nullptr)
+	{
+		fprintf(stderr, "ERROR: failed to load LUT '%s'\n", lut_file.c_str());
+		return 1;
+	}
+
+#ifdef _WIN32
+	_setmode(_fileno(stdin), _O_BINARY);
+	_setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+	if (fmt->pfm_header && !read_pfm_header(stdin, stdout, width, height))
+	{
+		smcube_free(luts);
+		return 1;
+	}
+	if (width <= 0 || height <= 0)
+	{
+		fprintf(stderr, "ERROR: frame size has to be given with --width and --height\n");
+		smcube_free(luts);
+		return 1;
+	}
+	smcube_pipeline* pipe = smcube_pipeline_create(luts);
+	smcube_free(luts);
+
+	// Three stages (read, apply, write) each work on their own strip, with
+	// one more strip ready to be handed over between each pair of stages.
+	// PFM files hold a single frame; raw streams hold frames until the end.
+	strip_rows = std::min(strip_rows, height);
+	const size_t row_size = size_t(width) * fmt->bytes_per_pixel;
+	const int kStripCount = 4;
+	std::vector<strip> strips(kStripCount);
+	strip_queue free_strips, read_strips, applied_strips;
+	for (strip& f : strips)
+	{
+		f.data.resize(row_size * strip_rows);
+		free_strips.push(&f);
+	}
+
+	double read_time = 0.0, write_time = 0.0, apply_time = 0.0;
+	bool read_error = false, write_error = false;
+	int frame_count = 0;
+	std::thread reader([&]()
+	{
+		int row = 0;
+		while (true)
+		{
+			strip* f = free_strips.pop();
+			const int rows = std::min(strip_rows, height - row);
+			const size_t size = rows * row_size;
+			auto t0 = std::chrono::steady_clock::now();
+			size_t got = f != nullptr ? fread(f->data.data(), 1, size, stdin) : 0;
+			read_time += get_time_ms(t0);
+			if (got != size)
+			{
+				read_error = got != 0 || row != 0;
+				read_strips.push(nullptr);
+				break;
+			}
+			f->pixel_count = size_t(rows) * width;
+			read_strips.push(f);
+			row += rows;
+			if (row == height)
+			{
+				row = 0;
+				++frame_count;
+				if (fmt->pfm_header)
+				{
+					read_strips.push(nullptr);
+					break;
+				}
+			}
+		}
+	});
+	std::thread writer([&]()
+	{
+		while (strip* f = applied_strips.pop())
+		{
+			const size_t size = f->pixel_count * fmt->bytes_per_pixel;
+			auto t0 = std::chrono::steady_clock::now();
+			if (!write_error && fwrite(f->data.data(), 1, size, stdout) != size)
+				write_error = true;
+			write_time += get_time_ms(t0);
+			free_strips.push(f);
+		}
+		fflush(stdout);
+	});
+
+	strip_workers workers(pipe, *fmt, thread_count);
+	auto t0 = std::chrono::steady_clock::now();
+	while (strip* f = read_strips.pop())
+	{
+		auto t1 = std::chrono::steady_clock::now();
+		workers.apply(*f);
+		apply_time += get_time_ms(t1);
+		applied_strips.push(f);
+	}
+	applied_strips.push(nullptr);
+	writer.join();
+	// reader might be waiting for a free strip if writing stopped early
+	free_strips.push(nullptr);
+	reader.join();
+	const double total_time = get_time_ms(t0);
+	smcube_pipeline_free(pipe);
+
+	if (read_error)
+		fprintf(stderr, "WARNING: input ended with a partial frame\n");
+	if (write_error)
+	{
+		fprintf(stderr, "ERROR: failed to write output\n");
+		return 1;
+	}
+	if (verbose)
+	{
+		fprintf(stderr, "%i frames of %ix%i %s in %.1f ms, %.1f FPS, %.1f MB buffers\n", frame_count, width, height, fmt->name, total_time, frame_count * 1000.0 / std::max(total_time, 1.0), kStripCount * row_size * strip_rows / (1024.0 * 1024.0));
+		if (frame_count > 0)
+			fprintf(stderr, "per frame: read %.2f ms, apply %.2f ms, write %.2f ms\n", read_time / frame_count, apply_time / frame_count, write_time / frame_count);
+	}
+	return 0;
+}
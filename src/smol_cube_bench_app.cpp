@@ -0,0 +1,264 @@
+// SPDX-License-Identifier: MIT OR Unlicense
+// smol-cube: https://github.com/aras-p/smol-cube
+
+#include "smol_cube.h"
+#include "smol_cube_sampler.h"
+
+#include "../libs/argh/argh.h"
+#include <string>
+#include <vector>
+#include <chrono>
+#include <filesystem>
+#include <algorithm>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../libs/stb_image.h"
+
+struct bench_image
+{
+	std::string path;
+	int width = 0;
+	int height = 0;
+	std::vector<float> rgba;
+};
+
+struct bench_variant
+{
+	const char* name;
+	smcube_pipeline_flags flags;
+};
+
+static const bench_variant kVariants[] = {
+	{ "rowmajor", smcube_pipeline_flag_None },
+	{ "bricked", smcube_pipeline_flag_BrickLayout },
+	{ "cornerpacked", smcube_pipeline_flag_CornerPackedLayout },
+	{ "colorcache", smcube_pipeline_flag_ColorCache },
+};
+
+static bool load_image(const std::string& path, bench_image& img)
+{
+	int comps;
+	stbi_uc* data = stbi_load(path.c_str(), &img.width, &img.height, &comps, 4);
+	if (data == nullptr)
+		return false;
+	img.path = path;
+	img.rgba.resize(size_t(img.width) * img.height * 4);
+	for (size_t i = 0; i < img.rgba.size(); ++i)
+		img.rgba[i] = data[i] / 255.0f;
+	stbi_image_free(data);
+	return true;
+}
+
+static bool is_lut_file(const std::string& path)
+{
+	std::filesystem::path ext = std::filesystem::path(path).extension();
+	return ext == ".cube" || ext == ".smcube";
+}
+
+static std::vector<std::string> find_files(const std::string& directory, bool luts)
+{
+	std::vector<std::string> files;
+	if (!std::filesystem::is_directory(directory))
+		return files;
+	for (const auto& entry : std::filesystem::directory_iterator(directory))
+	{
+		if (!entry.is_regular_file())
+			continue;
+		std::string path = entry.path().string();
+		if (is_lut_file(path) == luts && (luts || entry.path().extension() == ".jpg"))
+			files.push_back(path);
+	}
+	std::sort(files.begin(), files.end());
+	return files;
+}
+
+static double get_time_ms(std::chrono::steady_clock::time_point t0)
+{
+	std::chrono::duration<double, std::milli> dt = std::chrono::steady_clock::now() - t0;
+	return dt.count();
+}
+
+// Times header-only smcube::Sampler3D over all images: either one pixel at
+// a time, or with the batch sample over planar R, G, B arrays (which uses
+// SIMD where available).
+template<smcube_data_type DataType, int Channels, smcube_interpolation Interp>
+static void bench_sampler(const char* name, const smcube_luts* luts, const std::vector<bench_image>& images, size_t total_pixels, int runs, bool batch)
+{
+	smcube::Sampler3D<DataType, Channels, Interp> sampler;
+	if (!sampler.init(luts, 0))
+		return;
+	std::vector<std::vector<float>> planes(images.size());
+	if (batch)
+	{
+		for (size_t idx = 0; idx < images.size(); ++idx)
+		{
+			const bench_image& img = images[idx];
+			const size_t pixel_count = size_t(img.width) * img.height;
+			std::vector<float>& plane = planes[idx];
+			plane.resize(pixel_count * 3);
+			for (size_t i = 0; i < pixel_count; ++i)
+			{
+				plane[i] = img.rgba[i * 4 + 0];
+				plane[pixel_count + i] = img.rgba[i * 4 + 1];
+				plane[pixel_count * 2 + i] = img.rgba[i * 4 + 2];
+			}
+		}
+	}
+	std::vector<float> output;
+	double best_time = 1.0e30;
+	for (int run = 0; run < runs; ++run)
+	{
+		auto t0 = std::chrono::steady_clock::now();
+		for (size_t idx = 0; idx < images.size(); ++idx)
+		{
+			const bench_image& img = images[idx];
+			const size_t pixel_count = size_t(img.width) * img.height;
+			output.resize(img.rgba.size());
+			if (batch)
+			{
+				const float* src = planes[idx].data();
+				float* dst = output.data();
+				sampler.sample(src, src + pixel_count, src + pixel_count * 2, dst, dst + pixel_count, dst + pixel_count * 2, pixel_count);
+				continue;
+			}
+			const float* src = img.rgba.data();
+			float* dst = output.data();
+			for (size_t i = 0; i < pixel_count; ++i, src += 4, dst += 4)
+			{
+				smcube::Rgb col = sampler.sample(src[0], src[1], src[2]);
+				dst[0] = col.r;
+				dst[1] = col.g;
+				dst[2] = col.b;
+				dst[3] = src[3];
+			}
+		}
+		best_time = std::min(best_time, get_time_ms(t0));
+	}
+	printf("  %-12s %8.2f ms %8.1f Mpix/s\n", name, best_time, total_pixels / 1.0e3 / best_time);
+}
+
+int main(int argc, const char** argv)
+{
+	argh::parser args(argc, argv);
+	if (args["help"])
+	{
+		printf("Usage: smol-cube-bench [flags] [<LUT or image file> ...]\n");
+		printf("\n");
+		printf("Measures CPU LUT application performance of various pipeline variants.\n");
+		printf("Files ending with .cube/.smcube are LUTs, other files are images. If\n");
+		printf("none are given, uses LUTs from tests/luts and images tests/*.jpg.\n");
+		printf("Optional flags:\n");
+		printf("\n");
+		printf("--size=<N>    Resample all LUTs to NxNxN 3D LUT first (e.g. 65)\n");
+		printf("--runs=<N>    Number of runs for each measurement, best one is reported (default 5)\n");
+		return 1;
+	}
+
+	int resample_size = 0, runs = 5;
+	args("size", 0) >> resample_size;
+	args("runs", 5) >> runs;
+	if (runs < 1)
+		runs = 1;
+
+	std::vector<std::string> lut_files, image_files;
+	for (size_t i = 1; i < args.pos_args().size(); ++i)
+	{
+		const std::string& path = args.pos_args()[i];
+		if (is_lut_file(path))
+			lut_files.push_back(path);
+		else
+			image_files.push_back(path);
+	}
+	if (lut_files.empty())
+		lut_files = find_files("tests/luts", true);
+	if (image_files.empty())
+		image_files = find_files("tests", false);
+
+	std::vector<bench_image> images;
+	size_t total_pixels = 0;
+	for (const std::string& path : image_files)
+	{
+		bench_image img;
+		if (!load_image(path, img))
+		{
+			printf("ERROR: failed to load image '%s'\n", path.c_str());
+			continue;
+		}
+		total_pixels += size_t(img.width) * img.height;
+		images.emplace_back(std::move(img));
+	}
+	if (images.empty() || lut_files.empty())
+	{
+		printf("ERROR: no images or LUTs to test\n");
+		return 1;
+	}
+	printf("%zi images, %.1f Mpix total, %zi LUTs\n", images.size(), total_pixels / 1.0e6, lut_files.size());
+
+	std::vector<float> output;
+	for (const std::string& lut_file : lut_files)
+	{
+		smcube_luts* luts = smcube_load_from_file(lut_file.c_str());
+		if (luts == nullptr)
+		{
+			printf("ERROR: failed to load LUT '%s'\n", lut_file.c_str());
+			continue;
+		}
+		if (resample_size > 0)
+		{
+			smcube_luts* resampled = smcube_bake_to_3d(luts, resample_size);
+			smcube_free(luts);
+			luts = resampled;
+			if (luts == nullptr)
+				continue;
+		}
+
+		std::string lut_name = std::filesystem::path(lut_file).filename().string();
+		printf("%s:\n", lut_name.c_str());
+		for (const bench_variant& variant : kVariants)
+		{
+			smcube_pipeline* pipe = smcube_pipeline_create(luts, variant.flags);
+			double best_time = 1.0e30;
+			for (int run = 0; run < runs; ++run)
+			{
+				auto t0 = std::chrono::steady_clock::now();
+				for (const bench_image& img : images)
+				{
+					output.resize(img.rgba.size());
+					smcube_pipeline_apply(pipe, img.rgba.data(), output.data(), size_t(img.width) * img.height, 4);
+				}
+				best_time = std::min(best_time, get_time_ms(t0));
+			}
+			printf("  %-12s %8.2f ms %8.1f Mpix/s\n", variant.name, best_time, total_pixels / 1.0e3 / best_time);
+			smcube_pipeline_free(pipe);
+		}
+
+		// Header-only sampler inlined into the caller, for comparison (single 3D LUT only)
+		if (smcube_get_count(luts) == 1)
+		{
+			bench_sampler<smcube_data_type::Float32, 4, smcube_interpolation::Trilinear>("sampler", luts, images, total_pixels, runs, false);
+			bench_sampler<smcube_data_type::Float32, 4, smcube_interpolation::Trilinear>("sampler-simd", luts, images, total_pixels, runs, true);
+			bench_sampler<smcube_data_type::Float16, 3, smcube_interpolation::Tetrahedral>("sampler-f16t", luts, images, total_pixels, runs, true);
+		}
+		smcube_free(luts);
+	}
+	return 0;
+}
+
+// Xeon VM (1 core, 48KB L1d, 2MB L2, 105MB L3), tests/photo*.jpg (4 photos,
+// 2.8Mpix), Bluecine_75.cube resampled with --size, Mpix/s (quite noisy,
+// +-15% between runs). LUT data is 16 bytes per entry, i.e. 79KB, 575KB,
+// 4.4MB and 34MB for sizes 17..129; corner packed data is 8x that (0.5MB,
+// 4MB, 34MB, 268MB).
+//                              rowmajor  bricked  cornerpacked  colorcache
+// Bluecine_75.cube, size 17:       54.6     46.3          55.7        41.7
+// Bluecine_75.cube, size 33:       72.5     60.8          68.0        53.4
+// Bluecine_75.cube, size 65:       65.2     52.9          47.5        50.0
+// Bluecine_75.cube, size 129:      52.6     46.2          32.5        40.5
+// On this machine bricked is slower at every size, and corner packed only
+// breaks even at 17^3: with a 105MB L3 even the 129^3 row-major LUT stays
+// in cache, so neither layout gets to pay back its addressing cost. At 129^3
+// the 268MB corner packed data no longer fits into L3, and is the slowest.
+// The cache/TLB win these layouts are meant for would need a CPU with a
+// small L3 (a few MB, so that 65^3 and larger LUTs miss) to show up; no
+// such machine (nor a larger image corpus) was available for these numbers.
+// Row-major stays the default, the layouts are opt-in pipeline flags.
@@ -7,6 +7,20 @@
 #include <string.h>
 #include <math.h>
 
+struct filter_desc
+{
+	const char* name;
+	uint32_t save_flags;
+	bool float16_only; // filter works on 16 bit values; other data would get ByteDelta
+};
+
+static const filter_desc kFilters[] = {
+	{ "bytedelta", smcube_save_flag_FilterData, false },
+	{ "predict3d", smcube_save_flag_FilterPredict3D, false },
+	{ "worddelta", smcube_save_flag_FilterWordDelta, true },
+	{ "bitshuffle", smcube_save_flag_FilterBitShuffle, true },
+};
+
 static bool are_luts_equal(const smcube_luts* ha, size_t ia, const smcube_luts* hb, size_t ib)
 {
 	const int dima = smcube_lut_get_dimension(ha, ia);
@@ -19,6 +33,12 @@ static bool are_luts_equal(const smcube_luts* ha, size_t ia, const smcube_luts*
 	if (sizeay != sizeby) return false;
 	if (sizeaz != sizebz) return false;
 
+	float domainmina[3], domainmaxa[3], domainminb[3], domainmaxb[3];
+	smcube_lut_get_domain(ha, ia, domainmina, domainmaxa);
+	smcube_lut_get_domain(hb, ib, domainminb, domainmaxb);
+	if (memcmp(domainmina, domainminb, sizeof(domainmina)) != 0) return false;
+	if (memcmp(domainmaxa, domainmaxb, sizeof(domainmaxa)) != 0) return false;
+
 	const int channelsa = smcube_lut_get_channels(ha, ia);
 	const int channelsb = smcube_lut_get_channels(hb, ib);
 	smcube_data_type typea = smcube_lut_get_data_type(ha, ia);
@@ -74,18 +94,84 @@ int main(int argc, const char** argv)
 		printf("--float16     Convert data into Float16 (half precision floats)\n");
 		printf("--rgba        Expand data from RGB to RGB(A) (A being unused)\n");
 		printf("--nofilter    Do not perform data filtering to improve compressability\n");
+		printf("--filter=<F>  Data filter: bytedelta (default), predict3d (3D neighbor prediction, often smaller),\n");
+		printf("              worddelta or bitshuffle (16 bit value deltas, only for Float16 data)\n");
+		printf("--compress    Compress data with built-in entropy coder (no external compressor needed)\n");
+		printf("--identity    Store data as difference from identity LUT (smaller for near-identity LUTs, larger for others)\n");
+		printf("--align=<N>   Place uncompressed LUT data at file offsets aligned to 64 or 4096 (page) bytes\n");
+		printf("--size=<N>    Resample 3D LUTs into NxNxN size\n");
+		printf("--interp=<I>  Interpolation used for resampling: trilinear (default), tetrahedral, tricubic\n");
+		printf("--tolerance=<E>  Pick smallest 3D LUT size and data type with max error at most E (e.g. 0.002)\n");
+		printf("--mean-tolerance=<E>  Also require mean error to be at most E (default: same as --tolerance)\n");
 		return 1;
 	}
 
 	const bool nofilter = args["nofilter"];
+	const bool compress = args["compress"];
+	const bool identity = args["identity"];
 	const bool float16 = args["float16"];
 	const bool rgba = args["rgba"];
 	const bool verbose = args["verbose"];
 	const bool roundtrip = args["roundtrip"];
+	const std::string filter_name = args("filter", kFilters[0].name).str();
+	const filter_desc* filter = nullptr;
+	for (const filter_desc& desc : kFilters)
+	{
+		if (filter_name == desc.name)
+			filter = &desc;
+	}
+	if (filter == nullptr)
+	{
+		printf("ERROR: unknown data filter '%s'\n", filter_name.c_str());
+		return 1;
+	}
+	const bool default_filter = filter == &kFilters[0];
+	int align = 0;
+	args("align", 0) >> align;
+	if (align != 0 && align != 64 && align != 4096)
+	{
+		printf("ERROR: alignment has to be 64 or 4096\n");
+		return 1;
+	}
+	int resample_size = 0;
+	args("size", 0) >> resample_size;
+	smcube_interpolation interp = smcube_interpolation::Trilinear;
+	const std::string interp_name = args("interp", "trilinear").str();
+	if (interp_name == "tetrahedral")
+		interp = smcube_interpolation::Tetrahedral;
+	else if (interp_name == "tricubic")
+		interp = smcube_interpolation::Tricubic;
+	else if (interp_name != "trilinear")
+	{
+		printf("ERROR: unknown interpolation '%s'\n", interp_name.c_str());
+		return 1;
+	}
+	float tolerance = 0.0f, mean_tolerance = 0.0f;
+	args("tolerance", 0.0f) >> tolerance;
+	args("mean-tolerance", tolerance) >> mean_tolerance;
+	if (tolerance > 0.0f && resample_size != 0)
+	{
+		printf("ERROR: --size and --tolerance can not be used together\n");
+		return 1;
+	}
+	if (resample_size != 0 && resample_size < 2)
+	{
+		printf("ERROR: resample size has to be at least 2\n");
+		return 1;
+	}
+	if (!nofilter && filter->float16_only && !float16 && tolerance <= 0.0f)
+	{
+		printf("ERROR: filter '%s' needs Float16 data, use with --float16\n", filter->name);
+		return 1;
+	}
 
-	uint32_t save_flags = nofilter ? smcube_save_flag_None : smcube_save_flag_FilterData;
+	uint32_t save_flags = nofilter ? uint32_t(smcube_save_flag_None) : filter->save_flags;
 	if (float16) save_flags |= smcube_save_flag_ConvertToFloat16;
 	if (rgba) save_flags |= smcube_save_flag_ExpandTo4Channels;
+	if (compress) save_flags |= smcube_save_flag_Compress;
+	if (identity) save_flags |= smcube_save_flag_IdentityResidual;
+	if (align == 64) save_flags |= smcube_save_flag_AlignData64;
+	if (align == 4096) save_flags |= smcube_save_flag_AlignDataPage;
 
 	int exit_code = 0;
 	for (size_t idx = 1; idx < input_files.size(); ++idx)
@@ -122,6 +208,59 @@ int main(int argc, const char** argv)
 			}
 		}
 
+		// resample 3D LUTs if needed
+		if (resample_size > 0)
+		{
+			smcube_luts* resampled_luts = smcube_resample_3d(input_luts, resample_size, resample_size, resample_size, interp);
+			smcube_free(input_luts);
+			input_luts = resampled_luts;
+			if (input_luts == nullptr)
+			{
+				printf("ERROR: failed to resample LUTs of '%s'\n", input_file.c_str());
+				exit_code = 1;
+				continue;
+			}
+			if (verbose)
+				printf("- Resampled 3D LUTs to %ix%ix%i\n", resample_size, resample_size, resample_size);
+		}
+
+		// find smallest 3D LUT within error tolerance if needed
+		int output_size = resample_size;
+		bool output_float16 = float16;
+		if (tolerance > 0.0f)
+		{
+			smcube_minimize_result res;
+			smcube_luts* minimized_luts = smcube_minimize_3d(input_luts, tolerance, mean_tolerance, interp, &res);
+			if (minimized_luts == nullptr)
+			{
+				if (res.candidates > 0)
+					printf("ERROR: no 3D LUT size of input file '%s' is within tolerance (%i candidates)\n", input_file.c_str(), res.candidates);
+				else
+					printf("ERROR: input file '%s' has no 3D LUTs to minimize\n", input_file.c_str());
+				exit_code = 1;
+				smcube_free(input_luts);
+				continue;
+			}
+			smcube_free(input_luts);
+			input_luts = minimized_luts;
+			output_size = res.size;
+			output_float16 |= res.data_type == smcube_data_type::Float16;
+			printf("- Minimized %s: %ix%ix%i %s, max error %.5f mean error %.6f, %zi bytes (%i candidates)\n",
+				input_file.c_str(), res.size, res.size, res.size,
+				res.data_type == smcube_data_type::Float16 ? "Float16" : "Float32",
+				res.max_error, res.mean_error,
+				smcube_calc_file_size_smcube(input_luts, smcube_save_flags(save_flags)), res.candidates);
+		}
+
+		// minimization might have picked Float32 data, which the filter can't do
+		if (!nofilter && filter->float16_only && !output_float16)
+		{
+			printf("ERROR: filter '%s' needs Float16 data, but '%s' minimized to Float32\n", filter->name, input_file.c_str());
+			exit_code = 1;
+			smcube_free(input_luts);
+			continue;
+		}
+
 		// write output smol-cube file
 		size_t last_dot_pos = input_file.rfind('.');
 		if (last_dot_pos == std::string::npos)
@@ -133,9 +272,17 @@ int main(int argc, const char** argv)
 		}
 		std::string output_file = input_file.substr(0, last_dot_pos);
 		output_file += '_';
-		output_file += float16 ? "half" : "float";
+		output_file += output_float16 ? "half" : "float";
 		output_file += rgba ? "4" : "3";
-		if (nofilter)
+		if (output_size > 0)
+			output_file += "_" + std::to_string(output_size);
+		if (!default_filter && !nofilter)
+			output_file += std::string("_") + filter->name;
+		if (identity)
+			output_file += "_identity";
+		if (compress)
+			output_file += "_rans";
+		else if (nofilter)
 			output_file += "_nofilter";
 		output_file += ".smcube";
 		if (verbose)
@@ -0,0 +1,375 @@
+// SPDX-License-Identifier: MIT OR Unlicense
+// smol-cube: https://github.com/aras-p/smol-cube
+
+#include "smol_cube.h"
+
+#include "../libs/argh/argh.h"
+#include <stdio.h>
+#include <ctype.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <filesystem>
+#include <algorithm>
+#include <map>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../libs/stb_image.h"
+
+enum class output_format
+{
+	PPM, // 8 bit binary RGB
+	PFM, // 32 bit float RGB
+	Raw, // 8 bit RGB without any header
+};
+
+struct output_desc
+{
+	const char* name;
+	output_format format;
+	const char* extension;
+};
+
+static const output_desc kOutputs[] = {
+	{ "ppm", output_format::PPM, ".ppm" },
+	{ "pfm", output_format::PFM, ".pfm" },
+	{ "raw", output_format::Raw, ".raw" },
+};
+
+struct grade_image
+{
+	std::string input_path;
+	std::string output_path;
+	int width = 0;
+	int height = 0;
+	std::vector<float> rgb;
+	double decode_ms = 0.0;
+	double apply_ms = 0.0;
+	double encode_ms = 0.0;
+};
+
+typedef std::unique_ptr<grade_image> grade_image_ptr;
+
+// Bounded blocking queue between pipeline stages. Producers block while it
+// is full, which limits how many decoded images are in memory at once.
+class image_queue
+{
+public:
+	explicit image_queue(size_t capacity) : m_capacity(capacity) {}
+	void push(grade_image_ptr img)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_cond_push.wait(lock, [&]() { return m_images.size() < m_capacity; });
+		m_images.emplace_back(std::move(img));
+		lock.unlock();
+		m_cond_pop.notify_one();
+	}
+	// Returns false once the queue is closed and empty.
+	bool pop(grade_image_ptr& img)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_cond_pop.wait(lock, [&]() { return !m_images.empty() || m_closed; });
+		if (m_images.empty())
+			return false;
+		img = std::move(m_images.front());
+		m_images.pop_front();
+		lock.unlock();
+		m_cond_push.notify_one();
+		return true;
+	}
+	void close()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_closed = true;
+		}
+		m_cond_pop.notify_all();
+	}
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_cond_push, m_cond_pop;
+	std::deque<grade_image_ptr> m_images;
+	size_t m_capacity;
+	bool m_closed = false;
+};
+
+static double get_time_ms(std::chrono::steady_clock::time_point t0)
+{
+	std::chrono::duration<double, std::milli> dt = std::chrono::steady_clock::now() - t0;
+	return dt.count();
+}
+
+static bool is_image_file(const std::filesystem::path& path)
+{
+	static const char* kExtensions[] = { ".jpg", ".jpeg", ".png", ".tga", ".bmp", ".psd", ".gif", ".hdr", ".pic", ".ppm", ".pgm" };
+	std::string ext = path.extension().string();
+	std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return char(tolower(c)); });
+	for (const char* e : kExtensions)
+	{
+		if (ext == e)
+			return true;
+	}
+	return false;
+}
+
+static bool decode_image(grade_image& img)
+{
+	int comps;
+	if (stbi_is_hdr(img.input_path.c_str()))
+	{
+		float* data = stbi_loadf(img.input_path.c_str(), &img.width, &img.height, &comps, 3);
+		if (data == nullptr)
+			return false;
+		img.rgb.assign(data, data + size_t(img.width) * img.height * 3);
+		stbi_image_free(data);
+		return true;
+	}
+	stbi_uc* data = stbi_load(img.input_path.c_str(), &img.width, &img.height, &comps, 3);
+	if (data == nullptr)
+		return false;
+	img.rgb.resize(size_t(img.width) * img.height * 3);
+	for (size_t i = 0; i < img.rgb.size(); ++i)
+		img.rgb[i] = data[i] * (1.0f / 255.0f);
+	stbi_image_free(data);
+	return true;
+}
+
+static bool encode_image(const grade_image& img, output_format format)
+{
+	FILE* f = fopen(img.output_path.c_str(), "wb");
+	if (f == nullptr)
+		return false;
+	bool ok = true;
+	const size_t row_values = size_t(img.width) * 3;
+	if (format == output_format::PFM)
+	{
+		// PFM rows go bottom to top
+		fprintf(f, "PF\n%i %i\n-1.0\n", img.width, img.height);
+		for (int y = img.height - 1; y >= 0 && ok; --y)
+			ok = fwrite(img.rgb.data() + y * row_values, sizeof(float), row_values, f) == row_values;
+	}
+	else
+	{
+		if (format == output_format::PPM)
+			fprintf(f, "P6\n%i %i\n255\n", img.width, img.height);
+		std::vector<uint8_t> row(row_values);
+		for (int y = 0; y < img.height && ok; ++y)
+		{
+			const float* src = img.rgb.data() + y * row_values;
+			for (size_t i = 0; i < row_values; ++i)
+				row[i] = uint8_t(std::min(std::max(src[i], 0.0f), 1.0f) * 255.0f + 0.5f);
+			ok = fwrite(row.data(), 1, row_values, f) == row_values;
+		}
+	}
+	if (fclose(f) != 0)
+		ok = false;
+	return ok;
+}
+
+int main(int argc, const char** argv)
+{
+	argh::parser args(argc, argv);
+	if (args.pos_args().size() < 3 || args["help"])
+	{
+		printf("Usage: smol-cube-grade --output=<dir> [flags] <LUT file> <image file or directory> ...\n");
+		printf("\n");
+		printf("Applies .cube/.smcube LUT to all given images (or all images within given\n");
+		printf("directories), and writes results into output directory. Images are decoded,\n");
+		printf("graded and encoded concurrently.\n");
+		printf("Flags:\n");
+		printf("\n");
+		printf("--output=<dir>  Output directory, created if it does not exist\n");
+		printf("--format=<F>    Output format: ppm (8 bit, default), pfm (32 bit float) or raw (8 bit RGB, no header)\n");
+		printf("--threads=<N>   Threads used for decoding, and separately for encoding (default: all CPU cores)\n");
+		printf("--verbose       Print timings of each image\n");
+		return 1;
+	}
+
+	std::string output_dir;
+	int thread_count = int(std::thread::hardware_concurrency());
+	args("output") >> output_dir;
+	args("threads", thread_count) >> thread_count;
+	const bool verbose = args["verbose"];
+	if (thread_count < 1)
+		thread_count = 1;
+	if (output_dir.empty())
+	{
+		printf("ERROR: output directory has to be given with --output\n");
+		return 1;
+	}
+	const std::string format_name = args("format", "ppm").str();
+	const output_desc* output = nullptr;
+	for (const output_desc& desc : kOutputs)
+	{
+		if (format_name == desc.name)
+			output = &desc;
+	}
+	if (output == nullptr)
+	{
+		printf("ERROR: unknown output format '%s'\n", format_name.c_str());
+		return 1;
+	}
+
+	const std::string& lut_file = args.pos_args()[1];
+	smcube_luts* luts = smcube_load_from_file(lut_file.c_str());
+	if (luts == nullptr)
+	{
+		printf("ERROR: failed to load LUT '%s'\n", lut_file.c_str());
+		return 1;
+	}
+	smcube_pipeline* pipe = smcube_pipeline_create(luts);
+	smcube_free(luts);
+
+	std::vector<std::filesystem::path> inputs;
+	for (size_t i = 2; i < args.pos_args().size(); ++i)
+	{
+		std::filesystem::path path = args.pos_args()[i];
+		if (std::filesystem::is_directory(path))
+		{
+			std::vector<std::filesystem::path> files;
+			for (const auto& entry : std::filesystem::directory_iterator(path))
+			{
+				if (entry.is_regular_file() && is_image_file(entry.path()))
+					files.push_back(entry.path());
+			}
+			std::sort(files.begin(), files.end());
+			inputs.insert(inputs.end(), files.begin(), files.end());
+		}
+		else
+			inputs.push_back(path);
+	}
+	if (inputs.empty())
+	{
+		printf("ERROR: no images to grade\n");
+		smcube_pipeline_free(pipe);
+		return 1;
+	}
+
+	// output file names come from input stems; refuse to write two images
+	// into the same file, or over any of the input files
+	std::vector<std::filesystem::path> outputs;
+	std::map<std::filesystem::path, size_t> input_paths, output_paths;
+	std::error_code ec;
+	for (size_t i = 0; i < inputs.size(); ++i)
+	{
+		input_paths.emplace(std::filesystem::weakly_canonical(inputs[i], ec), i);
+		outputs.push_back(std::filesystem::path(output_dir) / (inputs[i].stem().string() + output->extension));
+	}
+	bool path_error = false;
+	for (size_t i = 0; i < outputs.size(); ++i)
+	{
+		std::filesystem::path canonical = std::filesystem::weakly_canonical(outputs[i], ec);
+		auto in_it = input_paths.find(canonical);
+		auto out_it = output_paths.emplace(canonical, i).first;
+		if (in_it != input_paths.end())
+		{
+			printf("ERROR: output '%s' of image '%s' would overwrite input image\n", outputs[i].string().c_str(), inputs[i].string().c_str());
+			path_error = true;
+		}
+		else if (out_it->second != i)
+		{
+			printf("ERROR: images '%s' and '%s' would both be written to '%s'\n", inputs[out_it->second].string().c_str(), inputs[i].string().c_str(), outputs[i].string().c_str());
+			path_error = true;
+		}
+	}
+	if (path_error)
+	{
+		smcube_pipeline_free(pipe);
+		return 1;
+	}
+	std::filesystem::create_directories(output_dir, ec);
+
+	// Decode -> apply -> encode pipeline: a pool of decoding threads, LUT
+	// application on the main thread (the pipeline itself goes wide), and
+	// a pool of encoding threads. Queues in between are bounded so that only
+	// a few decoded images are alive at once.
+	image_queue decoded(thread_count * 2), graded(thread_count * 2);
+	std::atomic<size_t> next_input(0);
+	std::atomic<int> decoders_left(thread_count);
+	std::atomic<int> failed(0);
+	std::mutex log_mutex;
+	double encode_ms = 0.0;
+
+	auto t0 = std::chrono::steady_clock::now();
+	std::vector<std::thread> decoders, encoders;
+	for (int i = 0; i < thread_count; ++i)
+	{
+		decoders.emplace_back([&]()
+		{
+			size_t index;
+			while ((index = next_input++) < inputs.size())
+			{
+				grade_image_ptr img(new grade_image());
+				img->input_path = inputs[index].string();
+				img->output_path = outputs[index].string();
+				auto t1 = std::chrono::steady_clock::now();
+				bool ok = decode_image(*img);
+				img->decode_ms = get_time_ms(t1);
+				if (!ok)
+				{
+					std::lock_guard<std::mutex> lock(log_mutex);
+					printf("ERROR: failed to load image '%s'\n", img->input_path.c_str());
+					++failed;
+					continue;
+				}
+				decoded.push(std::move(img));
+			}
+			if (--decoders_left == 0)
+				decoded.close();
+		});
+		encoders.emplace_back([&]()
+		{
+			grade_image_ptr img;
+			while (graded.pop(img))
+			{
+				auto t1 = std::chrono::steady_clock::now();
+				bool ok = encode_image(*img, output->format);
+				img->encode_ms = get_time_ms(t1);
+				std::lock_guard<std::mutex> lock(log_mutex);
+				encode_ms += img->encode_ms;
+				if (!ok)
+				{
+					printf("ERROR: failed to write image '%s'\n", img->output_path.c_str());
+					++failed;
+				}
+				else if (verbose)
+				{
+					printf("  %s: %ix%i, decode %.1f ms, apply %.1f ms, encode %.1f ms\n", img->output_path.c_str(), img->width, img->height, img->decode_ms, img->apply_ms, img->encode_ms);
+				}
+			}
+		});
+	}
+
+	double decode_ms = 0.0, apply_ms = 0.0;
+	size_t image_count = 0, total_pixels = 0;
+	grade_image_ptr img;
+	while (decoded.pop(img))
+	{
+		auto t1 = std::chrono::steady_clock::now();
+		smcube_pipeline_apply(pipe, img->rgb.data(), img->rgb.data(), size_t(img->width) * img->height, 3);
+		img->apply_ms = get_time_ms(t1);
+		decode_ms += img->decode_ms;
+		apply_ms += img->apply_ms;
+		total_pixels += size_t(img->width) * img->height;
+		++image_count;
+		graded.push(std::move(img));
+	}
+	graded.close();
+	for (std::thread& t : decoders)
+		t.join();
+	for (std::thread& t : encoders)
+		t.join();
+	const double total_ms = get_time_ms(t0);
+	smcube_pipeline_free(pipe);
+
+	printf("Graded %zi images, %.1f Mpix in %.1f ms (%.1f Mpix/s)\n", image_count, total_pixels / 1.0e6, total_ms, total_pixels / 1.0e3 / std::max(total_ms, 1.0e-3));
+	if (image_count > 0)
+		printf("Per image: decode %.1f ms, apply %.1f ms, encode %.1f ms\n", decode_ms / image_count, apply_ms / image_count, encode_ms / image_count);
+	return failed != 0 ? 1 : 0;
+}
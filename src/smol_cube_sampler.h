@@ -0,0 +1,351 @@
+// SPDX-License-Identifier: MIT OR Unlicense
+// smol-cube: https://github.com/aras-p/smol-cube
+
+#pragma once
+
+// Header-only 3D LUT sampler, for inlining LUT evaluation into hot loops
+// (e.g. per-sample shading code), without going through opaque handles
+// and function calls.
+//
+//   smcube::Sampler3D<smcube_data_type::Float16, 4, smcube_interpolation::Tetrahedral> sampler;
+//   if (sampler.init(luts, index))
+//       smcube::Rgb col = sampler.sample(r, g, b);
+//
+// - DataType: Float32 or Float16; data is kept in that format.
+// - Channels: 3 or 4; data is laid out with that many channels per item
+//   (4 is a bit faster for Float32 data, at cost of extra memory).
+// - Interp: Trilinear or Tetrahedral.
+//
+// Besides scalar `sample(r, g, b)`, on SSE4.1 and NEON there is a SIMD
+// `sample` that takes four colors in SoA form, and a batch `sample` over
+// arrays of R, G, B values.
+//
+// Inputs are clamped to LUT domain; NaN inputs are treated as domain minimum.
+
+#include "smol_cube.h"
+#include <string.h>
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#  include <smmintrin.h>
+#  define SMCUBE_SAMPLER_SSE
+#  if defined(__F16C__)
+#    include <immintrin.h>
+#  endif
+#elif defined(__ARM_NEON)
+#  include <arm_neon.h>
+#  define SMCUBE_SAMPLER_NEON
+#endif
+
+#if defined(_MSC_VER)
+#  define SMCUBE_FORCEINLINE __forceinline
+#else
+#  define SMCUBE_FORCEINLINE inline __attribute__((always_inline))
+#endif
+
+namespace smcube {
+
+struct Rgb
+{
+	float r, g, b;
+};
+
+namespace detail {
+
+SMCUBE_FORCEINLINE float load(const float* ptr) { return *ptr; }
+
+SMCUBE_FORCEINLINE float load(const uint16_t* ptr)
+{
+#if defined(__F16C__)
+	return _cvtsh_ss(*ptr);
+#elif defined(SMCUBE_SAMPLER_NEON)
+	return vgetq_lane_f32(vcvt_f32_f16(vreinterpret_f16_u16(vdup_n_u16(*ptr))), 0);
+#else
+	// half_to_float_fast4 from https://gist.github.com/rygorous/2144712
+	const uint16_t v = *ptr;
+	const uint32_t shifted_exp = 0x7c00 << 13;
+	uint32_t o = (v & 0x7fff) << 13;
+	const uint32_t exp = shifted_exp & o;
+	o += (127 - 15) << 23;
+	float f;
+	if (exp == shifted_exp)
+	{
+		o += (128 - 16) << 23;
+	}
+	else if (exp == 0)
+	{
+		o += 1 << 23;
+		memcpy(&f, &o, 4);
+		f -= 6.10351563e-05f; // 2^-14
+		memcpy(&o, &f, 4);
+	}
+	o |= (v & 0x8000) << 16;
+	memcpy(&f, &o, 4);
+	return f;
+#endif
+}
+
+// Tetrahedral interpolation: based on the order of fractions within the
+// cell, pick corner offsets of the tetrahedron (besides the first and
+// last corners, which are always 000 and 111) and fractions sorted from
+// largest to smallest.
+SMCUBE_FORCEINLINE void tetrahedron(float fx, float fy, float fz, int sx, int sy, int sz, int& o1, int& o2, float& f1, float& f2, float& f3)
+{
+	if (fx >= fy)
+	{
+		if (fy >= fz) { o1 = sx; o2 = sx + sy; f1 = fx; f2 = fy; f3 = fz; }
+		else if (fx >= fz) { o1 = sx; o2 = sx + sz; f1 = fx; f2 = fz; f3 = fy; }
+		else { o1 = sz; o2 = sz + sx; f1 = fz; f2 = fx; f3 = fy; }
+	}
+	else
+	{
+		if (fz >= fy) { o1 = sz; o2 = sz + sy; f1 = fz; f2 = fy; f3 = fx; }
+		else if (fz >= fx) { o1 = sy; o2 = sy + sz; f1 = fy; f2 = fz; f3 = fx; }
+		else { o1 = sy; o2 = sy + sx; f1 = fy; f2 = fx; f3 = fz; }
+	}
+}
+
+#if defined(SMCUBE_SAMPLER_SSE)
+typedef __m128 Vec4;
+SMCUBE_FORCEINLINE Vec4 v_set1(float v) { return _mm_set1_ps(v); }
+SMCUBE_FORCEINLINE Vec4 v_setr(float a, float b, float c, float d) { return _mm_setr_ps(a, b, c, d); }
+SMCUBE_FORCEINLINE Vec4 v_load(const float* ptr) { return _mm_loadu_ps(ptr); }
+SMCUBE_FORCEINLINE void v_store(float* ptr, Vec4 v) { _mm_storeu_ps(ptr, v); }
+SMCUBE_FORCEINLINE Vec4 v_add(Vec4 a, Vec4 b) { return _mm_add_ps(a, b); }
+SMCUBE_FORCEINLINE Vec4 v_sub(Vec4 a, Vec4 b) { return _mm_sub_ps(a, b); }
+SMCUBE_FORCEINLINE Vec4 v_mul(Vec4 a, Vec4 b) { return _mm_mul_ps(a, b); }
+SMCUBE_FORCEINLINE Vec4 v_min(Vec4 a, Vec4 b) { return _mm_min_ps(a, b); }
+SMCUBE_FORCEINLINE Vec4 v_max(Vec4 a, Vec4 b) { return _mm_max_ps(a, b); }
+SMCUBE_FORCEINLINE Vec4 v_floor(Vec4 v) { return _mm_floor_ps(v); }
+// a * sa + b * sb + c * sc, with integer inputs given as floats
+SMCUBE_FORCEINLINE void v_index(Vec4 a, int sa, Vec4 b, int sb, Vec4 c, int sc, int* dst)
+{
+	__m128i i = _mm_mullo_epi32(_mm_cvttps_epi32(a), _mm_set1_epi32(sa));
+	i = _mm_add_epi32(i, _mm_mullo_epi32(_mm_cvttps_epi32(b), _mm_set1_epi32(sb)));
+	i = _mm_add_epi32(i, _mm_mullo_epi32(_mm_cvttps_epi32(c), _mm_set1_epi32(sc)));
+	_mm_storeu_si128((__m128i*)dst, i);
+}
+#elif defined(SMCUBE_SAMPLER_NEON)
+typedef float32x4_t Vec4;
+SMCUBE_FORCEINLINE Vec4 v_set1(float v) { return vdupq_n_f32(v); }
+SMCUBE_FORCEINLINE Vec4 v_setr(float a, float b, float c, float d) { const float v[4] = { a, b, c, d }; return vld1q_f32(v); }
+SMCUBE_FORCEINLINE Vec4 v_load(const float* ptr) { return vld1q_f32(ptr); }
+SMCUBE_FORCEINLINE void v_store(float* ptr, Vec4 v) { vst1q_f32(ptr, v); }
+SMCUBE_FORCEINLINE Vec4 v_add(Vec4 a, Vec4 b) { return vaddq_f32(a, b); }
+SMCUBE_FORCEINLINE Vec4 v_sub(Vec4 a, Vec4 b) { return vsubq_f32(a, b); }
+SMCUBE_FORCEINLINE Vec4 v_mul(Vec4 a, Vec4 b) { return vmulq_f32(a, b); }
+// "number" variants return the non-NaN argument, same as SSE min/max with NaN in the first one
+SMCUBE_FORCEINLINE Vec4 v_min(Vec4 a, Vec4 b) { return vminnmq_f32(a, b); }
+SMCUBE_FORCEINLINE Vec4 v_max(Vec4 a, Vec4 b) { return vmaxnmq_f32(a, b); }
+SMCUBE_FORCEINLINE Vec4 v_floor(Vec4 v) { return vrndmq_f32(v); }
+SMCUBE_FORCEINLINE void v_index(Vec4 a, int sa, Vec4 b, int sb, Vec4 c, int sc, int* dst)
+{
+	int32x4_t i = vmulq_n_s32(vcvtq_s32_f32(a), sa);
+	i = vmlaq_n_s32(i, vcvtq_s32_f32(b), sb);
+	i = vmlaq_n_s32(i, vcvtq_s32_f32(c), sc);
+	vst1q_s32(dst, i);
+}
+#endif
+
+#if defined(SMCUBE_SAMPLER_SSE) || defined(SMCUBE_SAMPLER_NEON)
+#define SMCUBE_SAMPLER_SIMD
+SMCUBE_FORCEINLINE Vec4 v_lerp(Vec4 a, Vec4 b, Vec4 t) { return v_add(a, v_mul(v_sub(b, a), t)); }
+#endif
+
+} // namespace detail
+
+template<smcube_data_type DataType, int Channels, smcube_interpolation Interp>
+class Sampler3D
+{
+	static_assert(DataType == smcube_data_type::Float32 || DataType == smcube_data_type::Float16, "Sampler3D: unsupported data type");
+	static_assert(Channels == 3 || Channels == 4, "Sampler3D: channels have to be 3 or 4");
+	static_assert(Interp == smcube_interpolation::Trilinear || Interp == smcube_interpolation::Tetrahedral, "Sampler3D: unsupported interpolation");
+
+public:
+	typedef typename std::conditional<DataType == smcube_data_type::Float16, uint16_t, float>::type T;
+
+	// Initialize from 3D LUT at given index. Data is copied (and converted
+	// if needed); LUTs handle can be deleted afterwards.
+	// Returns false if there is no 3D LUT at index.
+	bool init(const smcube_luts* handle, size_t index)
+	{
+		if (handle == nullptr || index >= smcube_get_count(handle) || smcube_lut_get_dimension(handle, index) != 3)
+			return false;
+		const int sizes[3] = { smcube_lut_get_size_x(handle, index), smcube_lut_get_size_y(handle, index), smcube_lut_get_size_z(handle, index) };
+		float domain_min[3], domain_max[3];
+		smcube_lut_get_domain(handle, index, domain_min, domain_max);
+		for (int ch = 0; ch < 3; ++ch)
+		{
+			const float range = domain_max[ch] - domain_min[ch];
+			m_scale[ch] = range != 0.0f ? float(sizes[ch] - 1) / range : 0.0f;
+			m_bias[ch] = -domain_min[ch] * m_scale[ch];
+			m_max[ch] = float(sizes[ch] - 1);
+			m_cell_max[ch] = sizes[ch] > 1 ? float(sizes[ch] - 2) : 0.0f;
+		}
+		m_step_x = sizes[0] > 1 ? Channels : 0;
+		m_step_y = sizes[1] > 1 ? sizes[0] * Channels : 0;
+		m_step_z = sizes[2] > 1 ? sizes[0] * sizes[1] * Channels : 0;
+		m_data.resize(size_t(sizes[0]) * sizes[1] * sizes[2] * Channels);
+		smcube_lut_convert_data(handle, index, DataType, Channels, m_data.data());
+		// cell index steps, in data elements
+		m_index_x = Channels;
+		m_index_y = sizes[0] * Channels;
+		m_index_z = sizes[0] * sizes[1] * Channels;
+		return true;
+	}
+
+	bool valid() const { return !m_data.empty(); }
+
+	// Sample a single color.
+	SMCUBE_FORCEINLINE Rgb sample(float r, float g, float b) const
+	{
+		float fx, fy, fz;
+		const T* p = m_data.data() + cell(r, 0, fx) * m_index_x + cell(g, 1, fy) * m_index_y + cell(b, 2, fz) * m_index_z;
+		const int sx = m_step_x, sy = m_step_y, sz = m_step_z;
+		Rgb res;
+		float* dst = &res.r;
+		if constexpr (Interp == smcube_interpolation::Tetrahedral)
+		{
+			int o1, o2;
+			float f1, f2, f3;
+			detail::tetrahedron(fx, fy, fz, sx, sy, sz, o1, o2, f1, f2, f3);
+			const int o3 = sx + sy + sz;
+			for (int ch = 0; ch < 3; ++ch)
+			{
+				dst[ch] = detail::load(p + ch) * (1.0f - f1) + detail::load(p + o1 + ch) * (f1 - f2) +
+					detail::load(p + o2 + ch) * (f2 - f3) + detail::load(p + o3 + ch) * f3;
+			}
+		}
+		else
+		{
+			for (int ch = 0; ch < 3; ++ch)
+			{
+				const float c00 = lerp(detail::load(p + ch), detail::load(p + sx + ch), fx);
+				const float c10 = lerp(detail::load(p + sy + ch), detail::load(p + sy + sx + ch), fx);
+				const float c01 = lerp(detail::load(p + sz + ch), detail::load(p + sz + sx + ch), fx);
+				const float c11 = lerp(detail::load(p + sz + sy + ch), detail::load(p + sz + sy + sx + ch), fx);
+				dst[ch] = lerp(lerp(c00, c10, fy), lerp(c01, c11, fy), fz);
+			}
+		}
+		return res;
+	}
+
+#if defined(SMCUBE_SAMPLER_SIMD)
+	typedef detail::Vec4 Vec4;
+
+	// Sample four colors at once, given and returned in SoA form.
+	SMCUBE_FORCEINLINE void sample(Vec4 r, Vec4 g, Vec4 b, Vec4& dst_r, Vec4& dst_g, Vec4& dst_b) const
+	{
+		using namespace detail;
+		Vec4 fx, fy, fz;
+		Vec4 cx = cell4(r, 0, fx), cy = cell4(g, 1, fy), cz = cell4(b, 2, fz);
+		int base[4];
+		v_index(cx, m_index_x, cy, m_index_y, cz, m_index_z, base);
+		const T* d = m_data.data();
+		const int sx = m_step_x, sy = m_step_y, sz = m_step_z;
+		Vec4* dst[3] = { &dst_r, &dst_g, &dst_b };
+		if constexpr (Interp == smcube_interpolation::Tetrahedral)
+		{
+			float fxs[4], fys[4], fzs[4], w[4][4];
+			int o1[4], o2[4];
+			v_store(fxs, fx);
+			v_store(fys, fy);
+			v_store(fzs, fz);
+			for (int i = 0; i < 4; ++i)
+			{
+				float f1, f2, f3;
+				tetrahedron(fxs[i], fys[i], fzs[i], sx, sy, sz, o1[i], o2[i], f1, f2, f3);
+				w[0][i] = 1.0f - f1;
+				w[1][i] = f1 - f2;
+				w[2][i] = f2 - f3;
+				w[3][i] = f3;
+			}
+			const Vec4 w0 = v_load(w[0]), w1 = v_load(w[1]), w2 = v_load(w[2]), w3 = v_load(w[3]);
+			const int o3 = sx + sy + sz;
+			for (int ch = 0; ch < 3; ++ch)
+			{
+				Vec4 c0 = gather(d, base, 0, ch);
+				Vec4 c1 = v_setr(load(d + base[0] + o1[0] + ch), load(d + base[1] + o1[1] + ch), load(d + base[2] + o1[2] + ch), load(d + base[3] + o1[3] + ch));
+				Vec4 c2 = v_setr(load(d + base[0] + o2[0] + ch), load(d + base[1] + o2[1] + ch), load(d + base[2] + o2[2] + ch), load(d + base[3] + o2[3] + ch));
+				Vec4 c3 = gather(d, base, o3, ch);
+				*dst[ch] = v_add(v_add(v_mul(c0, w0), v_mul(c1, w1)), v_add(v_mul(c2, w2), v_mul(c3, w3)));
+			}
+		}
+		else
+		{
+			for (int ch = 0; ch < 3; ++ch)
+			{
+				Vec4 c00 = v_lerp(gather(d, base, 0, ch), gather(d, base, sx, ch), fx);
+				Vec4 c10 = v_lerp(gather(d, base, sy, ch), gather(d, base, sy + sx, ch), fx);
+				Vec4 c01 = v_lerp(gather(d, base, sz, ch), gather(d, base, sz + sx, ch), fx);
+				Vec4 c11 = v_lerp(gather(d, base, sz + sy, ch), gather(d, base, sz + sy + sx, ch), fx);
+				*dst[ch] = v_lerp(v_lerp(c00, c10, fy), v_lerp(c01, c11, fy), fz);
+			}
+		}
+	}
+#endif
+
+	// Sample arrays of colors given as separate R, G, B arrays; destination
+	// arrays can be the same as source ones.
+	void sample(const float* r, const float* g, const float* b, float* dst_r, float* dst_g, float* dst_b, size_t count) const
+	{
+		size_t i = 0;
+#if defined(SMCUBE_SAMPLER_SIMD)
+		for (; i + 4 <= count; i += 4)
+		{
+			Vec4 vr, vg, vb;
+			sample(detail::v_load(r + i), detail::v_load(g + i), detail::v_load(b + i), vr, vg, vb);
+			detail::v_store(dst_r + i, vr);
+			detail::v_store(dst_g + i, vg);
+			detail::v_store(dst_b + i, vb);
+		}
+#endif
+		for (; i < count; ++i)
+		{
+			Rgb res = sample(r[i], g[i], b[i]);
+			dst_r[i] = res.r;
+			dst_g[i] = res.g;
+			dst_b[i] = res.b;
+		}
+	}
+
+private:
+	static SMCUBE_FORCEINLINE float lerp(float a, float b, float t) { return a + (b - a) * t; }
+
+	// Integer cell index along an axis, and fraction within the cell.
+	SMCUBE_FORCEINLINE int cell(float v, int axis, float& frac) const
+	{
+		// constants first, so that NaN input clamps to zero (like SIMD path does)
+		const float x = std::min(m_max[axis], std::max(0.0f, v * m_scale[axis] + m_bias[axis]));
+		const int c = std::min(int(x), int(m_cell_max[axis]));
+		frac = x - float(c);
+		return c;
+	}
+
+#if defined(SMCUBE_SAMPLER_SIMD)
+	SMCUBE_FORCEINLINE Vec4 cell4(Vec4 v, int axis, Vec4& frac) const
+	{
+		using namespace detail;
+		Vec4 x = v_add(v_mul(v, v_set1(m_scale[axis])), v_set1(m_bias[axis]));
+		x = v_min(v_max(x, v_set1(0.0f)), v_set1(m_max[axis]));
+		Vec4 c = v_min(v_floor(x), v_set1(m_cell_max[axis]));
+		frac = v_sub(x, c);
+		return c;
+	}
+
+	static SMCUBE_FORCEINLINE Vec4 gather(const T* d, const int* base, int offset, int ch)
+	{
+		using namespace detail;
+		return v_setr(load(d + base[0] + offset + ch), load(d + base[1] + offset + ch), load(d + base[2] + offset + ch), load(d + base[3] + offset + ch));
+	}
+#endif
+
+	float m_scale[3] = {}, m_bias[3] = {}, m_max[3] = {}, m_cell_max[3] = {};
+	int m_step_x = 0, m_step_y = 0, m_step_z = 0;    // offsets to next item within cell, or zero if size is 1
+	int m_index_x = 0, m_index_y = 0, m_index_z = 0; // offsets to next cell
+	std::vector<T> m_data;
+};
+
+} // namespace smcube
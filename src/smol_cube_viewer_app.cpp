@@ -222,6 +222,35 @@ static sg_image load_lut(const char* path, float& lut_size)
 		return create_empty_lut(lut_size);
 	}
 
+	// file with a shaper LUT, or a LUT with non 0..1 input domain: bake whole
+	// chain into a single 3D LUT over 0..1 domain, which is what the shader
+	// samples it with
+	bool needs_bake = smcube_get_count(luts) > 1;
+	if (!needs_bake && smcube_get_count(luts) == 1)
+	{
+		float domain_min[3], domain_max[3];
+		smcube_lut_get_domain(luts, 0, domain_min, domain_max);
+		for (int ch = 0; ch < 3; ++ch)
+			needs_bake |= domain_min[ch] != 0.0f || domain_max[ch] != 1.0f;
+	}
+	if (needs_bake)
+	{
+		const float unit_min[3] = { 0.0f, 0.0f, 0.0f };
+		const float unit_max[3] = { 1.0f, 1.0f, 1.0f };
+		int bake_size = 33;
+		for (size_t li = 0, ln = smcube_get_count(luts); li != ln; ++li)
+		{
+			if (smcube_lut_get_dimension(luts, li) == 3)
+				bake_size = std::max(bake_size, smcube_lut_get_size_x(luts, li));
+		}
+		smcube_luts* baked = smcube_bake_to_3d_domain(luts, bake_size, unit_min, unit_max);
+		if (baked != nullptr)
+		{
+			smcube_free(luts);
+			luts = baked;
+		}
+	}
+
 	for (size_t li = 0, ln = smcube_get_count(luts); li != ln; ++li)
 	{
 		const int dim = smcube_lut_get_dimension(luts, li);